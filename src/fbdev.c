@@ -56,6 +56,9 @@
 #include "xf86Crtc.h"
 #include "xf86xv.h"
 
+#define DPMS_SERVER
+#include <X11/extensions/dpms.h>
+
 #include "fbdev.h"
 #include <linux/fb.h>
 #include <linux/omapfb.h>
@@ -64,6 +67,12 @@
 #include "sgx_xv.h"
 #include "omap_video.h"
 #include "omap_tvout.h"
+#include "omap_update.h"
+#include "omap_hold.h"
+#include "omap_scanout.h"
+#include "omap_cursor.h"
+#include "sgx_rotate.h"
+#include "omap_flip.h"
 
 /* -------------------------------------------------------------------- */
 /* prototypes                                                           */
@@ -108,10 +117,14 @@ static SymTabRec FBDevChipsets[] = {
 /* Supported options */
 typedef enum {
 	OPTION_FBDEV,
+	OPTION_SGX_ROTATE,
+	OPTION_PAGE_FLIP,
 } FBDevOpts;
 
 static const OptionInfoRec FBDevOptions[] = {
 	{OPTION_FBDEV, "fbdev", OPTV_STRING, {0}, FALSE},
+	{OPTION_SGX_ROTATE, "SGXRotate", OPTV_BOOLEAN, {0}, FALSE},
+	{OPTION_PAGE_FLIP, "PageFlip", OPTV_BOOLEAN, {0}, FALSE},
 	{-1, NULL, OPTV_NONE, {0}, FALSE}
 };
 
@@ -484,14 +497,25 @@ static Bool FBDevScreenInit(int scrnIndex, ScreenPtr pScreen, int argc,
 
 	fbdev_init_video(pScreen);
 
+	if (xf86ReturnOptValBool(fPtr->Options, OPTION_SGX_ROTATE, FALSE))
+		sgx_rotate_init(pScreen);
+
+	omap_scanout_init(pScreen);
+
+	omap_update_init(pScreen);
+
+	if (xf86ReturnOptValBool(fPtr->Options, OPTION_PAGE_FLIP, FALSE))
+		omap_flip_init(pScreen);
+
 	xf86SetBlackWhitePixels(pScreen);
 	miInitializeBackingStore(pScreen);
 	xf86SetBackingStore(pScreen);
 
 	pScrn->vtSema = TRUE;
 
-	/* software cursor */
+	/* software cursor, for when there's no plane for the hardware one */
 	miDCInitialize(pScreen, xf86GetPointerScreenFuncs());
+	omap_cursor_init(pScreen);
 
 	if (!xf86SetDesiredModes(pScrn))
 		return FALSE;
@@ -545,12 +569,23 @@ static Bool FBDevCloseScreen(int scrnIndex, ScreenPtr pScreen)
 	ScrnInfoPtr pScrn = xf86Screens[scrnIndex];
 	FBDevPtr fPtr = FBDEVPTR(pScrn);
 
+	/* Before rotating back, which would redisplay the cursor. */
+	omap_cursor_fini(pScreen);
+
 	/* Rotate back to landscape to prevent Nokia logo from being messed up
 	 * if shutdown from portrait mode. Do this before EXA_Fini on purpose,
 	 * because pixmap hash table is released there but used on rotation. */
 	fbdev_crtc_rotate (fPtr->crtc_lcd, RR_Rotate_0);
 	//fbdev_randr12_uninit (pScrn);
 
+	omap_scanout_fini(pScreen);
+
+	omap_flip_fini(pScreen);
+
+	omap_update_fini(pScreen);
+
+	sgx_rotate_fini(pScreen);
+
 	EXA_Fini(pScreen);
 
 	fbdev_fini_video (pScreen);
@@ -718,9 +753,25 @@ static void fbdev_crtc_unlock(xf86CrtcPtr crtc)
 	return;
 }
 
+/*
+ * The panel itself is powered by whoever owns it; we only stop drawing what
+ * can't be seen while it's off, and catch up when it comes back.
+ */
 static void fbdev_crtc_dpms(xf86CrtcPtr crtc, int mode)
 {
-	return;			/* XXX implement */
+	FBDevPtr fPtr = crtc->driver_private;
+	Bool off = mode != DPMSModeOn;
+
+	if (off == fPtr->output_off)
+		return;
+
+	fPtr->output_off = off;
+	if (off)
+		return;
+
+	/* A manual-update panel may have lost what it was sent. */
+	omap_update_add(fPtr, NULL);
+	omap_hold_kick_all(fPtr);
 }
 
 static Bool fbdev_crtc_mode_fixup(xf86CrtcPtr crtc, DisplayModePtr mode,
@@ -749,6 +800,9 @@ static void fbdev_crtc_prepare(xf86CrtcPtr crtc)
 {
 	int fd = fbdevHWGetFD(crtc->scrn);
 
+	/* Setting the mode drops the second buffer. */
+	omap_flip_suspend(FBDEVPTR(crtc->scrn));
+
 	(void)ioctl(fd, OMAPFB_SYNC_GFX);
 }
 
@@ -768,7 +822,8 @@ static void fbdev_crtc_mode_set(xf86CrtcPtr crtc, DisplayModePtr mode,
 
 static void fbdev_crtc_commit(xf86CrtcPtr crtc)
 {
-	return;
+	if ((crtc->rotation & 0xf) == RR_Rotate_0)
+		omap_flip_resume(FBDEVPTR(crtc->scrn));
 }
 
 static Bool toggle_plane (int fd, int enabled)
@@ -784,16 +839,46 @@ static Bool toggle_plane (int fd, int enabled)
 	return TRUE;
 }
 
+/* Microseconds since *t, which is moved on to now. */
+static long lap_us(struct timeval *t)
+{
+	struct timeval now;
+	long us;
+
+	gettimeofday(&now, NULL);
+	us = (now.tv_sec - t->tv_sec) * 1000000 + now.tv_usec - t->tv_usec;
+	*t = now;
+
+	return us;
+}
+
 static int fbdev_crtc_rotate(xf86CrtcPtr crtc, int rotation)
 {
 	struct fb_var_screeninfo var;
+	struct fb_fix_screeninfo fix, old_fix;
 	ScrnInfoPtr pScrn = crtc->scrn;
 	int fd = fbdevHWGetFD(pScrn);
 	FBDevPtr fPtr = FBDEVPTR(pScrn);
-	struct timeval t1, t2;
+	struct timeval t;
+	long us_off, us_set, us_remap, us_clear, us_on, total;
+	Bool remap;
+	int y;
 	WindowPtr win = NULL;
 
-	gettimeofday(&t1, NULL);
+	/* Only the unrotated root is the frame buffer, so only it flips. */
+	omap_flip_suspend(fPtr);
+
+	/* The panel stays as it is; only what's copied to it changes. */
+	if (fPtr->rotate) {
+		sgx_rotate_set(fPtr, rotation);
+		if (rotation == RR_Rotate_0)
+			omap_flip_resume(fPtr);
+		omap_cursor_rotate(fPtr, rotation);
+		xf86InputRotationNotify(rotation);
+		return TRUE;
+	}
+
+	gettimeofday(&t, NULL);
 
 	omap_tvout_stop(fPtr);
 
@@ -805,8 +890,10 @@ static int fbdev_crtc_rotate(xf86CrtcPtr crtc, int rotation)
 
 	/* Wait for overlay to disappear. */
 	ioctl(fd, OMAPFB_WAITFORVSYNC);
+	us_off = lap_us(&t);
 
-	if (ioctl(fd, FBIOGET_VSCREENINFO, &var) != 0) {
+	if (ioctl(fd, FBIOGET_VSCREENINFO, &var) != 0 ||
+	    ioctl(fd, FBIOGET_FSCREENINFO, &old_fix) != 0) {
 		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
 			   "rotate: couldn't get var info!\n");
 		return FALSE;
@@ -830,31 +917,46 @@ static int fbdev_crtc_rotate(xf86CrtcPtr crtc, int rotation)
 		break;
 	}
 
-	PVR2D_PreFBReset();
-
-	fbdevHWUnmapVidmem(pScrn);
+	pvr2DDestroyFlipChain();
+	PVR2DQueryBlitsComplete(hPVR2DContext, pSysMemInfo, TRUE);
 
-	if (ioctl(fd, FBIOPUT_VSCREENINFO, &var) != 0) {
+	if (ioctl(fd, FBIOPUT_VSCREENINFO, &var) != 0 ||
+	    ioctl(fd, FBIOGET_FSCREENINFO, &fix) != 0) {
 		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
 			   "rotate: couldn't set var info\n");
 		return FALSE;
 	}
+	us_set = lap_us(&t);
 
-	fbdevHWReload(pScrn);
+	/* Only the stride changes unless the memory was moved, say to
+	 * another VRFB view; then the mapping and the SGX's view of it
+	 * have to be redone. */
+	remap = fix.smem_start != old_fix.smem_start ||
+	    fix.smem_len != old_fix.smem_len;
 
-	fPtr->fbmem = fbdevHWMapVidmem(pScrn);
-	if (!fPtr->fbmem) {
-		xf86DrvMsg(pScrn->scrnIndex, X_ERROR, "video memory map failed\n");
-		return FALSE;
+	if (remap) {
+		PVR2D_PreFBReset();
+		fbdevHWUnmapVidmem(pScrn);
 	}
-	fPtr->fboff = fbdevHWLinearOffset(pScrn);
-	pScrn->videoRam = fbdevHWGetVidmem(pScrn);
-	memset(fPtr->fbmem, 0, pScrn->videoRam);
 
-	if (!PVR2D_PostFBReset()) {
-		ErrorF("Failed to reset PVR2D context\n");
-		return FALSE;
+	fbdevHWReload(pScrn);
+
+	if (remap) {
+		fPtr->fbmem = fbdevHWMapVidmem(pScrn);
+		if (!fPtr->fbmem) {
+			xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
+				   "video memory map failed\n");
+			return FALSE;
+		}
+		fPtr->fboff = fbdevHWLinearOffset(pScrn);
+		pScrn->videoRam = fbdevHWGetVidmem(pScrn);
+
+		if (!PVR2D_PostFBReset()) {
+			ErrorF("Failed to reset PVR2D context\n");
+			return FALSE;
+		}
 	}
+	us_remap = lap_us(&t);
 
 	if (pScrn->pScreen)
 		win = WindowTable[pScrn->pScreen->myNum];
@@ -873,6 +975,15 @@ static int fbdev_crtc_rotate(xf86CrtcPtr crtc, int rotation)
 	}
 #endif
 
+	/* Only what's about to be shown needs clearing. */
+	if (!PVR2DClearFrameBuffer(var.xres, var.yres, fix.line_length,
+				   pScrn->depth)) {
+		for (y = 0; y < var.yres; y++)
+			memset(fPtr->fbmem + fPtr->fboff + y * fix.line_length,
+			       0, var.xres * var.bits_per_pixel / 8);
+	}
+	us_clear = lap_us(&t);
+
 	if (!toggle_plane(fd, 1)) {
 		xf86DrvMsg(pScrn->scrnIndex, X_ERROR,
 			   "rotate: couldn't enable plane!\n");
@@ -881,10 +992,20 @@ static int fbdev_crtc_rotate(xf86CrtcPtr crtc, int rotation)
 
 	omap_tvout_resume(fPtr);
 
-	gettimeofday(&t2, NULL);
-	DebugF("DDX Rotation in %ld microseconds.\n",
-	       ((t2.tv_sec - t1.tv_sec) * 1000000) + t2.tv_usec - t1.tv_usec);
+	if (rotation == RR_Rotate_0)
+		omap_flip_resume(fPtr);
+
+	/* The new frame buffer has yet to reach the panel. */
+	omap_update_add(fPtr, NULL);
+	us_on = lap_us(&t);
 
+	total = us_off + us_set + us_remap + us_clear + us_on;
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		   "Rotated in %ld us: disable %ld, set %ld, %s %ld, "
+		   "clear %ld, enable %ld\n", total, us_off, us_set,
+		   remap ? "remap" : "reload", us_remap, us_clear, us_on);
+
+	omap_cursor_rotate(fPtr, rotation);
 	xf86InputRotationNotify(rotation);
 
 	return TRUE;
@@ -923,6 +1044,12 @@ static PixmapPtr fbdev_crtc_shadow_create(xf86CrtcPtr crtc, void *data,
 	bpp = crtc->scrn->bitsPerPixel;
 	stride = get_fb_stride(width, bpp);
 
+	/* sgx_rotate.c copies the root to the frame buffer itself.  The
+	 * server still composites the root's damage into this, so make it
+	 * a single pixel, which clips that down to next to nothing. */
+	if (FBDEVPTR(crtc->scrn)->rotate)
+		return screen->CreatePixmap(screen, 1, 1, depth, 0);
+
 	pixmap = screen->CreatePixmap(screen, width, height, depth, CREATE_PIXMAP_USAGE_BACKING_PIXMAP);
 	if (pixmap == NullPixmap)
 		xf86DrvMsg(crtc->scrn->scrnIndex, X_ERROR, "failed to create backing rotation pixmap\n");
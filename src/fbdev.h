@@ -66,6 +66,9 @@ typedef struct {
 	int fd;
 	int num_video_ports;
 	XF86VideoAdaptorPtr overlay_adaptor;
+	XF86VideoAdaptorPtr auto_adaptor;
+	XF86VideoAdaptorPtr auto_textured;
+	struct omap_vram *vram;
 	DestroyWindowProcPtr video_destroy_window;
 	DestroyPixmapProcPtr video_destroy_pixmap;
 
@@ -79,6 +82,22 @@ typedef struct {
 	DisplayModePtr builtin;
 
 	struct fb_var_screeninfo saved_var;
+
+	/* Damage tracking for manual-update panels, see omap_update.c. */
+	struct omap_update *update;
+
+	/* Panel blanked through DPMS; see omap_hold.c for what's skipped. */
+	Bool output_off;
+	struct omap_hold *holds;
+
+	/* Hardware cursor, see omap_cursor.c. */
+	struct omap_cursor *cursor;
+
+	/* Rotation by the SGX instead of the DSS, see sgx_rotate.c. */
+	struct sgx_rotate *rotate;
+
+	/* Double-buffered root, see omap_flip.c. */
+	struct omap_flip *flip;
 } FBDevRec, *FBDevPtr;
 
 #define FBDEVPTR(p) ((FBDevPtr)((p)->driverPrivate))
@@ -0,0 +1,456 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Hardware cursor.
+ *
+ * The software cursor saves, restores and redraws the frame buffer under
+ * the pointer on every motion, which also dirties pixmaps and, on manual
+ * update panels, gets pushed to the panel.  Instead, put the cursor image
+ * in a small ARGB video plane blended over the frame buffer, and only
+ * move the plane.  The plane can't hang off the screen edges, so there it
+ * shows the visible part of its buffer.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+#include <string.h>
+
+#include "xf86Cursor.h"
+#include "cursorstr.h"
+#include "inputstr.h"
+#include "servermd.h"
+
+#include "omap_video.h"
+#include "omap_update.h"
+#include "omap_cursor.h"
+
+#define CURSOR_SIZE 64
+
+struct omap_cursor {
+	ScreenPtr screen;
+	FBDevPtr fbdev;
+	xf86CursorInfoPtr info;
+
+	/* Lent plane, or -1; its buffer is CURSOR_SIZE square ARGB. */
+	int plane;
+	CARD32 *mem;
+	int pitch;
+
+	/* Two-colour cursors, as realized, for recolouring. */
+	Bool two_colour;
+	CARD8 image[CURSOR_SIZE * CURSOR_SIZE];
+	CARD32 fg, bg;
+
+	/* Top left of the image; may be off screen. */
+	int x, y;
+	Bool visible;
+	/* Where the plane shows, if anywhere. */
+	BoxRec shown;
+
+	/* Held, to be put back up in software if video takes the plane. */
+	CursorPtr current;
+	/* Video took the plane: leave it be until the cursor changes. */
+	Bool reclaimed;
+	/* The plane isn't rotated with the root, so stay in software. */
+	Bool rotated;
+};
+
+/* NULL once the screen is closing; xf86Cursor may still call us. */
+static struct omap_cursor *get_cursor(ScrnInfoPtr pScrn)
+{
+	return FBDEVPTR(pScrn)->cursor;
+}
+
+static void damage_shown(struct omap_cursor *cursor)
+{
+	if (cursor->shown.x2 > cursor->shown.x1)
+		omap_update_add(cursor->fbdev, &cursor->shown);
+}
+
+static void hide_plane(struct omap_cursor *cursor)
+{
+	if (cursor->shown.x2 <= cursor->shown.x1)
+		return;
+
+	omap_video_show_lent_plane(cursor->fbdev, cursor->plane, FALSE);
+	damage_shown(cursor);
+	memset(&cursor->shown, 0, sizeof cursor->shown);
+}
+
+/* Show the on-screen part of the image where it is now. */
+static void place(struct omap_cursor *cursor)
+{
+	ScreenPtr screen = cursor->screen;
+	BoxRec box;
+	Bool was_shown = cursor->shown.x2 > cursor->shown.x1;
+
+	if (cursor->plane < 0 || !cursor->visible)
+		return;
+
+	box.x1 = max(cursor->x, 0);
+	box.y1 = max(cursor->y, 0);
+	box.x2 = min(cursor->x + CURSOR_SIZE, screen->width);
+	box.y2 = min(cursor->y + CURSOR_SIZE, screen->height);
+
+	if (box.x1 >= box.x2 || box.y1 >= box.y2) {
+		hide_plane(cursor);
+		return;
+	}
+
+	if (!omap_video_place_lent_plane(cursor->fbdev, cursor->plane,
+					 box.x1 - cursor->x,
+					 box.y1 - cursor->y, box.x1, box.y1,
+					 box.x2 - box.x1, box.y2 - box.y1)) {
+		hide_plane(cursor);
+		return;
+	}
+
+	damage_shown(cursor);
+	cursor->shown = box;
+	damage_shown(cursor);
+
+	if (!was_shown)
+		omap_video_show_lent_plane(cursor->fbdev, cursor->plane, TRUE);
+}
+
+static void paint_two_colour(struct omap_cursor *cursor)
+{
+	CARD32 colours[3] = { 0, cursor->bg, cursor->fg };
+	CARD8 *src = cursor->image;
+	CARD32 *dst = cursor->mem;
+	int x, y;
+
+	if (cursor->plane < 0)
+		return;
+
+	for (y = 0; y < CURSOR_SIZE; y++, dst += cursor->pitch)
+		for (x = 0; x < CURSOR_SIZE; x++)
+			dst[x] = colours[*src++];
+
+	damage_shown(cursor);
+}
+
+static void release_plane(struct omap_cursor *cursor)
+{
+	hide_plane(cursor);
+	omap_video_return_plane(cursor->fbdev, cursor->plane);
+	cursor->plane = -1;
+	cursor->mem = NULL;
+}
+
+/* Have xf86Cursor choose between hardware and software again. */
+static void redisplay(struct omap_cursor *cursor)
+{
+	if (cursor->current)
+		(*cursor->screen->DisplayCursor) (inputInfo.pointer,
+						  cursor->screen,
+						  cursor->current);
+}
+
+/* Video wants the plane back. */
+static void cursor_reclaim(pointer data)
+{
+	struct omap_cursor *cursor = data;
+
+	release_plane(cursor);
+	cursor->reclaimed = TRUE;
+
+	/* Have it drawn in software from now on; this asks for the plane
+	 * again straight away, which get_plane() turns down. */
+	if (cursor->visible)
+		redisplay(cursor);
+}
+
+static Bool get_plane(struct omap_cursor *cursor)
+{
+	unsigned long phys;
+	CARD8 *mem;
+	int pitch;
+
+	if (cursor->plane >= 0)
+		return TRUE;
+	if (cursor->reclaimed || cursor->rotated)
+		return FALSE;
+
+	cursor->plane = omap_video_lend_plane(cursor->fbdev, CURSOR_SIZE,
+					      CURSOR_SIZE, 32, TRUE,
+					      cursor_reclaim, cursor, &mem,
+					      &phys, &pitch);
+	if (cursor->plane < 0)
+		return FALSE;
+
+	cursor->mem = (CARD32 *) mem;
+	cursor->pitch = pitch / 4;
+	memset(&cursor->shown, 0, sizeof cursor->shown);
+
+	return TRUE;
+}
+
+static Bool omap_cursor_use_hw(ScreenPtr screen, CursorPtr pCurs)
+{
+	struct omap_cursor *cursor = get_cursor(xf86Screens[screen->myNum]);
+
+	if (!cursor)
+		return FALSE;
+
+	/* Held whichever way it's drawn, to redisplay it on rotation. */
+	if (pCurs != cursor->current) {
+		/* Video has had its chance to take the plane by now. */
+		cursor->reclaimed = FALSE;
+		pCurs->refcnt++;
+		if (cursor->current)
+			FreeCursor(cursor->current, None);
+		cursor->current = pCurs;
+	}
+
+	return pCurs->bits->width <= CURSOR_SIZE &&
+	    pCurs->bits->height <= CURSOR_SIZE && get_plane(cursor);
+}
+
+/**
+ * One byte per pixel: 0 for transparent, 1 for background and 2 for
+ * foreground, so recolouring needn't realize the cursor again.
+ */
+static unsigned char *omap_cursor_realize(xf86CursorInfoPtr info,
+					  CursorPtr pCurs)
+{
+	CursorBitsPtr bits = pCurs->bits;
+	int stride = BitmapBytePad(bits->width);
+	unsigned char *image, *src, *mask;
+	int x, y, bit;
+
+	image = xcalloc(1, CURSOR_SIZE * CURSOR_SIZE);
+	if (!image)
+		return NULL;
+
+	for (y = 0; y < bits->height && y < CURSOR_SIZE; y++) {
+		src = bits->source + y * stride;
+		mask = bits->mask + y * stride;
+		for (x = 0; x < bits->width && x < CURSOR_SIZE; x++) {
+#if BITMAP_BIT_ORDER == MSBFirst
+			bit = 0x80 >> (x & 7);
+#else
+			bit = 1 << (x & 7);
+#endif
+			if (mask[x / 8] & bit)
+				image[y * CURSOR_SIZE + x] =
+				    src[x / 8] & bit ? 2 : 1;
+		}
+	}
+
+	return image;
+}
+
+static void omap_cursor_load_image(ScrnInfoPtr pScrn, unsigned char *bits)
+{
+	struct omap_cursor *cursor = get_cursor(pScrn);
+
+	if (!cursor)
+		return;
+
+	memcpy(cursor->image, bits, sizeof cursor->image);
+	cursor->two_colour = TRUE;
+	paint_two_colour(cursor);
+}
+
+static void omap_cursor_set_colors(ScrnInfoPtr pScrn, int bg, int fg)
+{
+	struct omap_cursor *cursor = get_cursor(pScrn);
+
+	if (!cursor)
+		return;
+
+	cursor->bg = 0xff000000 | bg;
+	cursor->fg = 0xff000000 | fg;
+	if (cursor->two_colour)
+		paint_two_colour(cursor);
+}
+
+/* X cursors are premultiplied, the plane blends straight alpha. */
+static CARD32 unpremultiply(CARD32 p)
+{
+	CARD32 a = p >> 24;
+
+	if (a == 0 || a == 0xff)
+		return a ? p : 0;
+
+	return (a << 24) |
+	    (min(((p >> 16) & 0xff) * 255 / a, 255) << 16) |
+	    (min(((p >> 8) & 0xff) * 255 / a, 255) << 8) |
+	    min((p & 0xff) * 255 / a, 255);
+}
+
+static void omap_cursor_load_argb(ScrnInfoPtr pScrn, CursorPtr pCurs)
+{
+	struct omap_cursor *cursor = get_cursor(pScrn);
+	CursorBitsPtr bits = pCurs->bits;
+	CARD32 *src = bits->argb, *dst;
+	int x, y;
+
+	if (!cursor)
+		return;
+
+	cursor->two_colour = FALSE;
+	if (cursor->plane < 0)
+		return;
+
+	dst = cursor->mem;
+
+	for (y = 0; y < CURSOR_SIZE; y++, dst += cursor->pitch) {
+		for (x = 0; x < CURSOR_SIZE; x++)
+			dst[x] = x < bits->width && y < bits->height ?
+			    unpremultiply(src[x]) : 0;
+		if (y < bits->height)
+			src += bits->width;
+	}
+
+	damage_shown(cursor);
+}
+
+static void omap_cursor_set_position(ScrnInfoPtr pScrn, int x, int y)
+{
+	struct omap_cursor *cursor = get_cursor(pScrn);
+
+	if (!cursor)
+		return;
+
+	cursor->x = x;
+	cursor->y = y;
+	place(cursor);
+}
+
+static void omap_cursor_show(ScrnInfoPtr pScrn)
+{
+	struct omap_cursor *cursor = get_cursor(pScrn);
+
+	if (!cursor)
+		return;
+
+	cursor->visible = TRUE;
+	place(cursor);
+}
+
+static void omap_cursor_hide(ScrnInfoPtr pScrn)
+{
+	struct omap_cursor *cursor = get_cursor(pScrn);
+
+	if (!cursor)
+		return;
+
+	cursor->visible = FALSE;
+	if (cursor->plane >= 0)
+		hide_plane(cursor);
+}
+
+Bool omap_cursor_init(ScreenPtr screen)
+{
+	ScrnInfoPtr pScrn = xf86Screens[screen->myNum];
+	FBDevPtr fbdev = FBDEVPTR(pScrn);
+	struct omap_cursor *cursor;
+	xf86CursorInfoPtr info;
+
+	if (!fbdev->overlay_adaptor)
+		return FALSE;
+
+	cursor = xcalloc(1, sizeof(*cursor));
+	if (!cursor)
+		return FALSE;
+
+	info = xf86CreateCursorInfoRec();
+	if (!info) {
+		xfree(cursor);
+		return FALSE;
+	}
+
+	cursor->screen = screen;
+	cursor->fbdev = fbdev;
+	cursor->info = info;
+	cursor->plane = -1;
+
+	info->MaxWidth = CURSOR_SIZE;
+	info->MaxHeight = CURSOR_SIZE;
+	info->Flags = HARDWARE_CURSOR_ARGB |
+	    HARDWARE_CURSOR_UPDATE_UNHIDDEN;
+	info->SetCursorColors = omap_cursor_set_colors;
+	info->SetCursorPosition = omap_cursor_set_position;
+	info->LoadCursorImage = omap_cursor_load_image;
+	info->HideCursor = omap_cursor_hide;
+	info->ShowCursor = omap_cursor_show;
+	info->RealizeCursor = omap_cursor_realize;
+	info->UseHWCursor = omap_cursor_use_hw;
+	info->UseHWCursorARGB = omap_cursor_use_hw;
+	info->LoadCursorARGB = omap_cursor_load_argb;
+
+	fbdev->cursor = cursor;
+
+	if (!xf86InitCursor(screen, info)) {
+		xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+			   "Couldn't set up the hardware cursor\n");
+		xf86DestroyCursorInfoRec(info);
+		xfree(cursor);
+		fbdev->cursor = NULL;
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * The root has been rotated.  The plane would show the image unrotated and
+ * in the wrong place, so use the software cursor unless unrotated.
+ */
+void omap_cursor_rotate(FBDevPtr fbdev, Rotation rotation)
+{
+	struct omap_cursor *cursor = fbdev->cursor;
+	Bool rotated = (rotation & 0xf) != RR_Rotate_0;
+
+	if (!cursor || rotated == cursor->rotated)
+		return;
+
+	cursor->rotated = rotated;
+	if (rotated && cursor->plane >= 0)
+		release_plane(cursor);
+
+	redisplay(cursor);
+}
+
+void omap_cursor_fini(ScreenPtr screen)
+{
+	FBDevPtr fbdev = FBDEVPTR(xf86Screens[screen->myNum]);
+	struct omap_cursor *cursor = fbdev->cursor;
+
+	if (!cursor)
+		return;
+
+	if (cursor->plane >= 0)
+		release_plane(cursor);
+	if (cursor->current)
+		FreeCursor(cursor->current, None);
+
+	xf86DestroyCursorInfoRec(cursor->info);
+	xfree(cursor);
+	fbdev->cursor = NULL;
+}
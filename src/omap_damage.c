@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Screen pixmap damage, shared by the modules that copy or push the root
+ * somewhere at BlockHandler time: omap_update.c, omap_flip.c and
+ * sgx_rotate.c.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+
+#include "omap_damage.h"
+
+Bool omap_damage_init(struct omap_damage *track, ScreenPtr screen)
+{
+	track->screen = screen;
+	track->pixmap = NULL;
+	track->damage = DamageCreate(NULL, NULL, DamageReportNone, TRUE,
+				     screen, track);
+
+	return track->damage != NULL;
+}
+
+void omap_damage_fini(struct omap_damage *track)
+{
+	omap_damage_untrack(track);
+	if (track->damage)
+		DamageDestroy(track->damage);
+	track->damage = NULL;
+}
+
+void omap_damage_untrack(struct omap_damage *track)
+{
+	if (!track->pixmap)
+		return;
+
+	DamageUnregister(&track->pixmap->drawable, track->damage);
+	track->screen->DestroyPixmap(track->pixmap);
+	track->pixmap = NULL;
+}
+
+Bool omap_damage_track(struct omap_damage *track,
+		       Bool (*accept) (PixmapPtr pixmap), Bool damage_new)
+{
+	ScreenPtr screen = track->screen;
+	PixmapPtr pixmap = screen->GetScreenPixmap(screen);
+	RegionRec region;
+	BoxRec box;
+
+	if (pixmap == track->pixmap)
+		return pixmap != NULL;
+
+	omap_damage_untrack(track);
+	if (!pixmap || (accept && !accept(pixmap)))
+		return FALSE;
+
+	DamageRegister(&pixmap->drawable, track->damage);
+	pixmap->refcnt++;
+	track->pixmap = pixmap;
+
+	if (damage_new) {
+		box.x1 = 0;
+		box.y1 = 0;
+		box.x2 = pixmap->drawable.width;
+		box.y2 = pixmap->drawable.height;
+		REGION_INIT(screen, &region, &box, 1);
+		DamageDamageRegion(&pixmap->drawable, &region);
+		REGION_UNINIT(screen, &region);
+	}
+
+	return TRUE;
+}
+
+int omap_damage_boxes(ScreenPtr screen, RegionPtr region, BoxPtr *boxes)
+{
+	if (REGION_NUM_RECTS(region) > OMAP_DAMAGE_MERGE_LIMIT) {
+		*boxes = REGION_EXTENTS(screen, region);
+		return 1;
+	}
+
+	*boxes = REGION_RECTS(region);
+
+	return REGION_NUM_RECTS(region);
+}
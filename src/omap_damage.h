@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OMAP_DAMAGE_H
+#define OMAP_DAMAGE_H
+
+#include "fbdev.h"
+
+#include "damage.h"
+
+/* Past this many damage boxes, just handle their extents. */
+#define OMAP_DAMAGE_MERGE_LIMIT 32
+
+/*
+ * Damage to the screen pixmap.  That only exists after
+ * CreateScreenResources and is replaced on rotation, so it's picked up
+ * afresh whenever it changes.
+ */
+struct omap_damage {
+	ScreenPtr screen;
+	/* Screen pixmap being tracked; we hold a reference on it. */
+	PixmapPtr pixmap;
+	DamagePtr damage;
+};
+
+Bool omap_damage_init(struct omap_damage *track, ScreenPtr screen);
+void omap_damage_fini(struct omap_damage *track);
+
+/**
+ * Follow the screen pixmap, as long as accept (if not NULL) takes it.
+ * Returns whether one is tracked.  With damage_new, all of a newly
+ * tracked pixmap counts as damaged.
+ */
+Bool omap_damage_track(struct omap_damage *track,
+		       Bool (*accept) (PixmapPtr pixmap), Bool damage_new);
+void omap_damage_untrack(struct omap_damage *track);
+
+/**
+ * The boxes of region, or its extents past OMAP_DAMAGE_MERGE_LIMIT of
+ * them.  Returns how many.
+ */
+int omap_damage_boxes(ScreenPtr screen, RegionPtr region, BoxPtr *boxes);
+
+#endif
@@ -0,0 +1,380 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Tear-free root window by page flipping.
+ *
+ * The frame buffer is made twice as tall as the screen.  The root renders
+ * to whichever half isn't scanned out (pSysMemInfo is pointed at it, as
+ * after a frame buffer reset) and at BlockHandler time, if anything was
+ * drawn, we pan to it at vblank.  The half we panned away from then lacks
+ * only what was drawn since the last flip, which the SGX copies forward
+ * before rendering carries on there.
+ *
+ * Rendering may not touch the old front buffer until the pan has taken
+ * effect, so each flip blocks the server until the next vblank: at most
+ * one refresh, which the frame-time statistics keep track of.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/fb.h>
+#include <linux/omapfb.h>
+
+#include "exa.h"
+
+#include "sgx_pvr2d.h"
+#include "omap_damage.h"
+#include "omap_flip.h"
+#include "omap_hold.h"
+
+/* Flips between statistics in the debug log. */
+#define FLIP_STATS_PERIOD 600
+
+struct omap_flip {
+	ScreenPtr screen;
+	int fd;
+	Bool active;
+
+	/* Buffer 0 is the frame buffer as PVR2D gave it, buffer 1 the
+	 * second half, which we wrap ourselves. */
+	PVR2DMEMINFO *buffers[2];
+	int back;
+	struct fb_var_screeninfo var;
+	int pitch;
+
+	struct omap_damage track;
+
+	/* Time spent waiting for each flip to take effect, in
+	 * microseconds, against one refresh. */
+	unsigned long flips, late;
+	long total_us, max_us, refresh_us;
+
+	void (*block_handler) (int, pointer, pointer, pointer);
+};
+
+static long since_us(struct timeval *t)
+{
+	struct timeval now;
+
+	gettimeofday(&now, NULL);
+
+	return (now.tv_sec - t->tv_sec) * 1000000 + now.tv_usec - t->tv_usec;
+}
+
+/* Only while the root is the frame buffer, i.e. not while rotated. */
+static Bool on_screen(PixmapPtr pixmap)
+{
+	struct PVR2DPixmap *ppix = exaGetPixmapDriverPrivate(pixmap);
+
+	return ppix && ppix->screen;
+}
+
+/* Have the root render to buffer i. */
+static void render_to(struct omap_flip *flip, int i)
+{
+	flip->back = i;
+	pSysMemInfo = flip->buffers[i];
+	SysMemInfoChanged();
+}
+
+static Bool pan_to(struct omap_flip *flip, int i)
+{
+	struct fb_var_screeninfo var = flip->var;
+
+	var.yoffset = i * var.yres;
+	var.activate = FB_ACTIVATE_VBL;
+
+	return ioctl(flip->fd, FBIOPAN_DISPLAY, &var) == 0;
+}
+
+/* Copy region (all of the screen for NULL) from buffer src to dst. */
+static void copy_buffer(struct omap_flip *flip, RegionPtr region, int src,
+			int dst)
+{
+	ScrnInfoPtr pScrn = xf86Screens[flip->screen->myNum];
+	PVR2DBLTINFO blt;
+	BoxRec all;
+	BoxPtr boxes;
+	int i, n;
+
+	memset(&blt, 0, sizeof(blt));
+	if (!GetPVR2DFormat(pScrn->depth, &blt.SrcFormat))
+		return;
+	blt.DstFormat = blt.SrcFormat;
+
+	blt.CopyCode = PVR2DROPcopy;
+	blt.BlitFlags = PVR2D_BLIT_DISABLE_ALL;
+	blt.pSrcMemInfo = flip->buffers[src];
+	blt.pDstMemInfo = flip->buffers[dst];
+	blt.SrcStride = blt.DstStride = flip->pitch;
+	blt.SrcSurfWidth = blt.DstSurfWidth = flip->var.xres;
+	blt.SrcSurfHeight = blt.DstSurfHeight = flip->var.yres;
+
+	if (region) {
+		n = omap_damage_boxes(flip->screen, region, &boxes);
+	} else {
+		all.x1 = 0;
+		all.y1 = 0;
+		all.x2 = flip->var.xres;
+		all.y2 = flip->var.yres;
+		n = 1;
+		boxes = &all;
+	}
+
+	for (i = 0; i < n; i++) {
+		blt.SrcX = blt.DstX = max(boxes[i].x1, 0);
+		blt.SrcY = blt.DstY = max(boxes[i].y1, 0);
+		blt.SizeX = blt.DSizeX =
+		    min(boxes[i].x2, (int)flip->var.xres) - blt.SrcX;
+		blt.SizeY = blt.DSizeY =
+		    min(boxes[i].y2, (int)flip->var.yres) - blt.SrcY;
+		if (blt.SizeX <= 0 || blt.SizeY <= 0)
+			continue;
+
+		if (PVR2DBlt(hPVR2DContext, &blt) != PVR2D_OK)
+			ErrorF("omap/flip: copy forward failed\n");
+	}
+}
+
+static void flip_now(struct omap_flip *flip)
+{
+	RegionPtr damage = DamageRegion(flip->track.damage);
+	int front = flip->back;
+	struct timeval t;
+	long us;
+
+	/* Everything drawn so far has to be in before it's shown. */
+	PVR2DQueryBlitsComplete(hPVR2DContext, flip->buffers[front], TRUE);
+
+	gettimeofday(&t, NULL);
+	if (!pan_to(flip, front)) {
+		ErrorF("omap/flip: couldn't pan, not flipping any more\n");
+		omap_flip_suspend(FBDEVPTR(xf86Screens[flip->screen->myNum]));
+		return;
+	}
+	(void)ioctl(flip->fd, OMAPFB_WAITFORVSYNC);
+
+	/* The old front buffer is off screen now; bring it up to date. */
+	copy_buffer(flip, damage, front, !front);
+	render_to(flip, !front);
+	DamageEmpty(flip->track.damage);
+
+	us = since_us(&t);
+	flip->flips++;
+	flip->total_us += us;
+	flip->max_us = max(flip->max_us, us);
+	if (us > flip->refresh_us)
+		flip->late++;
+
+	if (flip->flips % FLIP_STATS_PERIOD == 0)
+		DebugF("omap/flip: %lu flips, waited %ld us on average, "
+		       "%ld us at most, %lu over a refresh\n", flip->flips,
+		       flip->total_us / flip->flips, flip->max_us, flip->late);
+}
+
+static void flip_block_handler(int i, pointer blockData, pointer pTimeout,
+			       pointer pReadmask)
+{
+	ScreenPtr screen = screenInfo.screens[i];
+	FBDevPtr fbdev = FBDEVPTR(xf86Screens[i]);
+	struct omap_flip *flip = fbdev->flip;
+
+	screen->BlockHandler = flip->block_handler;
+	(*screen->BlockHandler) (i, blockData, pTimeout, pReadmask);
+	screen->BlockHandler = flip_block_handler;
+
+	if (!flip->active ||
+	    !omap_damage_track(&flip->track, on_screen, FALSE))
+		return;
+
+	/* Nothing new, or nobody to see it: keep it for later. */
+	if (!REGION_NOTEMPTY(screen, DamageRegion(flip->track.damage)) ||
+	    !omap_output_visible(fbdev, NULL))
+		return;
+
+	flip_now(flip);
+}
+
+void omap_flip_suspend(FBDevPtr fbdev)
+{
+	struct omap_flip *flip = fbdev->flip;
+
+	if (!flip || !flip->active)
+		return;
+
+	/* Rendering since the last flip went to the second buffer. */
+	if (flip->back == 1 && flip->track.pixmap)
+		copy_buffer(flip, DamageRegion(flip->track.damage), 1, 0);
+	PVR2DQueryBlitsComplete(hPVR2DContext, flip->buffers[0], TRUE);
+
+	(void)pan_to(flip, 0);
+	render_to(flip, 0);
+	PVR2DMemFree(hPVR2DContext, flip->buffers[1]);
+	flip->buffers[1] = NULL;
+	flip->active = FALSE;
+}
+
+void omap_flip_resume(FBDevPtr fbdev)
+{
+	struct omap_flip *flip = fbdev->flip;
+	ScrnInfoPtr pScrn;
+	struct fb_fix_screeninfo fix;
+	struct fb_var_screeninfo var, saved;
+	unsigned long *pages, phys, size;
+	int i, num_pages, page_size = getpagesize();
+	CARD8 *mem;
+
+	if (!flip || flip->active || !pSysMemInfo)
+		return;
+	pScrn = xf86Screens[flip->screen->myNum];
+
+	if (ioctl(flip->fd, FBIOGET_VSCREENINFO, &var) != 0)
+		return;
+	saved = var;
+	if (var.yres_virtual < 2 * var.yres || var.yoffset) {
+		var.yres_virtual = 2 * var.yres;
+		var.yoffset = 0;
+		var.activate = FB_ACTIVATE_NOW;
+		if (ioctl(flip->fd, FBIOPUT_VSCREENINFO, &var) != 0)
+			goto fail;
+	}
+
+	/* The second half has to be inside what we mapped. */
+	if (ioctl(flip->fd, FBIOGET_FSCREENINFO, &fix) != 0)
+		goto fail;
+	size = var.yres * fix.line_length;
+	if (fbdev->fboff + 2 * size > (unsigned long)pScrn->videoRam)
+		goto fail;
+
+	mem = fbdev->fbmem + fbdev->fboff + size;
+	phys = fix.smem_start + fbdev->fboff + size;
+	num_pages = (size + page_size - 1) / page_size;
+	pages = xcalloc(num_pages, sizeof(*pages));
+	if (!pages)
+		goto fail;
+	for (i = 0; i < num_pages; i++)
+		pages[i] = phys + i * page_size;
+
+	if (PVR2DMemWrap(hPVR2DContext, mem, PVR2D_WRAPFLAG_CONTIGUOUS, size,
+			 pages, &flip->buffers[1]) != PVR2D_OK) {
+		xfree(pages);
+		flip->buffers[1] = NULL;
+		goto fail;
+	}
+	xfree(pages);
+
+	flip->var = var;
+	flip->pitch = fix.line_length;
+	flip->buffers[0] = pSysMemInfo;
+	flip->active = TRUE;
+
+	/* Start off with both buffers the same. */
+	copy_buffer(flip, NULL, 0, 1);
+	render_to(flip, 1);
+	if (flip->track.pixmap)
+		DamageEmpty(flip->track.damage);
+
+	return;
+
+fail:
+	/* Don't leave the frame buffer taller than the screen for nothing. */
+	if (memcmp(&var, &saved, sizeof(var)) != 0) {
+		saved.activate = FB_ACTIVATE_NOW;
+		(void)ioctl(flip->fd, FBIOPUT_VSCREENINFO, &saved);
+	}
+	xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+		   "No room for a second frame buffer, not flipping\n");
+}
+
+Bool omap_flip_init(ScreenPtr screen)
+{
+	ScrnInfoPtr pScrn = xf86Screens[screen->myNum];
+	FBDevPtr fbdev = FBDEVPTR(pScrn);
+	struct omap_flip *flip;
+
+	/* The controller already keeps what it's sent from tearing. */
+	if (fbdev->update) {
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			   "Manual update panel, not flipping\n");
+		return FALSE;
+	}
+
+	flip = xcalloc(1, sizeof(*flip));
+	if (!flip)
+		return FALSE;
+
+	flip->screen = screen;
+	flip->fd = fbdev->fd;
+
+	flip->refresh_us = omap_output_refresh_us(fbdev);
+
+	if (!omap_damage_init(&flip->track, screen)) {
+		xfree(flip);
+		return FALSE;
+	}
+
+	flip->block_handler = screen->BlockHandler;
+	screen->BlockHandler = flip_block_handler;
+	fbdev->flip = flip;
+
+	omap_flip_resume(fbdev);
+	if (flip->active)
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			   "Double-buffered root, flipping at vblank\n");
+
+	return TRUE;
+}
+
+void omap_flip_fini(ScreenPtr screen)
+{
+	ScrnInfoPtr pScrn = xf86Screens[screen->myNum];
+	FBDevPtr fbdev = FBDEVPTR(pScrn);
+	struct omap_flip *flip = fbdev->flip;
+
+	if (!flip)
+		return;
+
+	omap_flip_suspend(fbdev);
+
+	if (screen->BlockHandler == flip_block_handler)
+		screen->BlockHandler = flip->block_handler;
+
+	if (flip->flips)
+		xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+			   "Flipped %lu times, waiting %ld us on average and "
+			   "%ld us at most; %lu over a refresh (%ld us)\n",
+			   flip->flips, flip->total_us / flip->flips,
+			   flip->max_us, flip->late, flip->refresh_us);
+
+	omap_damage_fini(&flip->track);
+
+	xfree(flip);
+	fbdev->flip = NULL;
+}
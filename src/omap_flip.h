@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OMAP_FLIP_H
+#define OMAP_FLIP_H
+
+#include "fbdev.h"
+
+/*
+ * Double-buffered root: rendering goes to the half of the frame buffer
+ * that isn't being scanned out, which is panned to at vblank.
+ */
+Bool omap_flip_init(ScreenPtr screen);
+void omap_flip_fini(ScreenPtr screen);
+
+/**
+ * Scan out and render to the first buffer only, around anything that
+ * reprograms the frame buffer.
+ */
+void omap_flip_suspend(FBDevPtr fbdev);
+/* Flip again, if the frame buffer can be made to hold two screens. */
+void omap_flip_resume(FBDevPtr fbdev);
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Video nobody can see.
+ *
+ * With the panel off, or the window under others, converting and pushing
+ * every frame is wasted work.  The ports hold on to a copy of the latest
+ * frame instead, which is cheap next to a conversion, and put it once it
+ * can be seen again, so the window isn't left showing a stale frame if
+ * the client has stopped sending them by then.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+#include <string.h>
+
+#include "windowstr.h"
+#include "omap_hold.h"
+
+void omap_hold_init(struct omap_hold *hold, FBDevPtr fbdev,
+		    PutImageFuncPtr put, QueryImageAttributesFuncPtr query,
+		    pointer data)
+{
+	memset(hold, 0, sizeof(*hold));
+	hold->fbdev = fbdev;
+	hold->put = put;
+	hold->query = query;
+	hold->data = data;
+
+	hold->next = fbdev->holds;
+	fbdev->holds = hold;
+}
+
+void omap_hold_fini(struct omap_hold *hold)
+{
+	struct omap_hold **p;
+
+	for (p = &hold->fbdev->holds; *p; p = &(*p)->next)
+		if (*p == hold) {
+			*p = hold->next;
+			break;
+		}
+
+	TimerFree(hold->timer);
+	hold->timer = NULL;
+	xfree(hold->buf);
+	hold->buf = NULL;
+	hold->held = FALSE;
+}
+
+void omap_hold_fini_all(FBDevPtr fbdev)
+{
+	struct omap_hold *hold;
+
+	for (hold = fbdev->holds; hold; hold = hold->next) {
+		TimerFree(hold->timer);
+		hold->timer = NULL;
+		xfree(hold->buf);
+		hold->buf = NULL;
+		hold->held = FALSE;
+	}
+
+	fbdev->holds = NULL;
+}
+
+Bool omap_output_visible(FBDevPtr fbdev, DrawablePtr drawable)
+{
+	if (fbdev->output_off)
+		return FALSE;
+
+	return !drawable || drawable->type != DRAWABLE_WINDOW
+	    || ((WindowPtr) drawable)->visibility < VisibilityFullyObscured;
+}
+
+CARD32 omap_output_refresh_us(FBDevPtr fbdev)
+{
+	float refresh = 0;
+
+	if (fbdev->builtin)
+		refresh = xf86ModeVRefresh(fbdev->builtin);
+	if (refresh <= 0)
+		refresh = 60;
+
+	return 1000000 / refresh;
+}
+
+void omap_hold_frame(struct omap_hold *hold, short src_x, short src_y,
+		     short dst_x, short dst_y, short src_w, short src_h,
+		     short dst_w, short dst_h, int id, unsigned char *buf,
+		     short width, short height, DrawablePtr drawable)
+{
+	ScrnInfoPtr screen = xf86Screens[drawable->pScreen->myNum];
+	unsigned short w = width, h = height;
+	int size = hold->query(screen, id, &w, &h, NULL, NULL);
+	CARD8 *copy;
+
+	if (hold->size < size) {
+		copy = xrealloc(hold->buf, size);
+		if (!copy) {
+			/* Nobody would have seen it anyway. */
+			omap_hold_drop(hold);
+			return;
+		}
+		hold->buf = copy;
+		hold->size = size;
+	}
+
+	memcpy(hold->buf, buf, size);
+	hold->drawable = drawable;
+	hold->src_x = src_x;
+	hold->src_y = src_y;
+	hold->src_w = src_w;
+	hold->src_h = src_h;
+	hold->dst_x = dst_x - drawable->x;
+	hold->dst_y = dst_y - drawable->y;
+	hold->dst_w = dst_w;
+	hold->dst_h = dst_h;
+	hold->id = id;
+	hold->width = width;
+	hold->height = height;
+	hold->held = TRUE;
+}
+
+void omap_hold_drop(struct omap_hold *hold)
+{
+	hold->held = FALSE;
+
+	/* The frame being replayed is still in use. */
+	if (hold->replaying)
+		return;
+
+	xfree(hold->buf);
+	hold->buf = NULL;
+	hold->size = 0;
+}
+
+static void replay(struct omap_hold *hold)
+{
+	ScreenPtr screen = hold->fbdev->screen;
+	DrawablePtr drawable = hold->drawable;
+	RegionRec clip, bounds;
+	BoxRec box;
+
+	if (!hold->held || !omap_output_visible(hold->fbdev, drawable))
+		return;
+	hold->held = FALSE;
+
+	/* Clip as xf86XV does for a fresh put. */
+	box.x1 = drawable->x;
+	box.y1 = drawable->y;
+	box.x2 = box.x1 + drawable->width;
+	box.y2 = box.y1 + drawable->height;
+	REGION_INIT(screen, &bounds, &box, 1);
+
+	box.x1 = drawable->x + hold->dst_x;
+	box.y1 = drawable->y + hold->dst_y;
+	box.x2 = box.x1 + hold->dst_w;
+	box.y2 = box.y1 + hold->dst_h;
+	REGION_INIT(screen, &clip, &box, 1);
+
+	REGION_INTERSECT(screen, &clip, &clip, &bounds);
+	if (drawable->type == DRAWABLE_WINDOW)
+		REGION_INTERSECT(screen, &clip, &clip,
+				 &((WindowPtr) drawable)->clipList);
+
+	if (REGION_NOTEMPTY(screen, &clip)) {
+		hold->replaying = TRUE;
+		hold->put(xf86Screens[screen->myNum], hold->src_x, hold->src_y,
+			  box.x1, box.y1, hold->src_w, hold->src_h,
+			  hold->dst_w, hold->dst_h, hold->id, hold->buf,
+			  hold->width, hold->height, FALSE, &clip, hold->data,
+			  drawable);
+		hold->replaying = FALSE;
+	}
+
+	REGION_UNINIT(screen, &clip);
+	REGION_UNINIT(screen, &bounds);
+
+	omap_hold_drop(hold);
+}
+
+static CARD32 hold_timer(OsTimerPtr timer, CARD32 now, pointer data)
+{
+	replay(data);
+
+	return 0;
+}
+
+void omap_hold_kick(struct omap_hold *hold)
+{
+	/* Not from here: this may be in the middle of validating windows. */
+	if (hold->held)
+		hold->timer = TimerSet(hold->timer, 0, 1, hold_timer, hold);
+}
+
+void omap_hold_kick_all(FBDevPtr fbdev)
+{
+	struct omap_hold *hold;
+
+	for (hold = fbdev->holds; hold; hold = hold->next)
+		omap_hold_kick(hold);
+}
+
+void omap_hold_drawable_destroyed(FBDevPtr fbdev, DrawablePtr drawable)
+{
+	struct omap_hold *hold;
+
+	for (hold = fbdev->holds; hold; hold = hold->next) {
+		if (hold->drawable != drawable)
+			continue;
+
+		omap_hold_drop(hold);
+		hold->drawable = NULL;
+	}
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OMAP_HOLD_H
+#define OMAP_HOLD_H
+
+#include "fbdev.h"
+
+/*
+ * A frame held back from an Xv port because nobody could see it, to be put
+ * once they can.  Each port has one, chained off the FBDevRec.
+ */
+struct omap_hold {
+	FBDevPtr fbdev;
+	PutImageFuncPtr put;
+	QueryImageAttributesFuncPtr query;
+	pointer data;
+	struct omap_hold *next;
+
+	Bool held, replaying;
+	OsTimerPtr timer;
+
+	/* The put, with dst relative to the drawable. */
+	DrawablePtr drawable;
+	short src_x, src_y, src_w, src_h;
+	short dst_x, dst_y, dst_w, dst_h;
+	int id;
+	short width, height;
+	CARD8 *buf;
+	int size;
+};
+
+void omap_hold_init(struct omap_hold *hold, FBDevPtr fbdev,
+		    PutImageFuncPtr put, QueryImageAttributesFuncPtr query,
+		    pointer data);
+/* For a port going away before the rest. */
+void omap_hold_fini(struct omap_hold *hold);
+void omap_hold_fini_all(FBDevPtr fbdev);
+
+/**
+ * Whether anything drawn to drawable (NULL for the screen) would show:
+ * not with the panel off, or under other windows.
+ */
+Bool omap_output_visible(FBDevPtr fbdev, DrawablePtr drawable);
+
+/* One refresh period of the LCD, in microseconds. */
+CARD32 omap_output_refresh_us(FBDevPtr fbdev);
+
+/**
+ * Keep a copy of buf instead of putting it, replacing any frame held
+ * before.
+ */
+void omap_hold_frame(struct omap_hold *hold, short src_x, short src_y,
+		     short dst_x, short dst_y, short src_w, short src_h,
+		     short dst_w, short dst_h, int id, unsigned char *buf,
+		     short width, short height, DrawablePtr drawable);
+void omap_hold_drop(struct omap_hold *hold);
+
+/* Put the held frame shortly, if it can be seen by then. */
+void omap_hold_kick(struct omap_hold *hold);
+void omap_hold_kick_all(FBDevPtr fbdev);
+
+void omap_hold_drawable_destroyed(FBDevPtr fbdev, DrawablePtr drawable);
+
+#endif
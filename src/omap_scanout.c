@@ -0,0 +1,374 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Scanning out fullscreen windows without a composite copy.
+ *
+ * A compositor copies every frame of a redirected window from its backing
+ * pixmap to the screen.  For a fullscreen window that is the whole screen
+ * per frame, so put its backing pixmap in the memory of an otherwise idle
+ * video plane instead, and while the window covers the screen with
+ * nothing redirected above it, show the plane over the frame buffer.
+ * The compositor is told through the window's _OMAP_SCANOUT property,
+ * which holds the colour key to paint instead of the window, or 0 when it
+ * has to draw the window itself again.
+ *
+ * Only one pixmap at a time, single buffered: the plane shows rendering
+ * as it lands, like the frame buffer does.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+#include <string.h>
+#include <unistd.h>
+
+#include <X11/Xatom.h>
+#include "windowstr.h"
+#include "damage.h"
+#include "exa.h"
+
+#include "sgx_pvr2d.h"
+#include "omap_video.h"
+#include "omap_update.h"
+#include "omap_scanout.h"
+
+#define SCANOUT_PROP_NAME "_OMAP_SCANOUT"
+
+struct omap_scanout {
+	ScreenPtr screen;
+	FBDevPtr fbdev;
+	Atom prop;
+
+	/* The pixmap living in the lent plane, if any. */
+	struct PVR2DPixmap *ppix;
+	int plane;
+
+	/* While shown; we hold a reference on the pixmap. */
+	Bool shown;
+	WindowPtr window;
+	PixmapPtr pixmap;
+	DamagePtr damage;
+
+	void (*block_handler) (int, pointer, pointer, pointer);
+};
+
+/* Pixmap memory has no screen to hand, like the PVR2D context. */
+static struct omap_scanout *scanout;
+
+static void set_prop(struct omap_scanout *so, CARD32 key)
+{
+	if (so->window)
+		ChangeWindowProperty(so->window, so->prop, XA_CARDINAL, 32,
+				     PropModeReplace, 1, &key, TRUE);
+}
+
+static void show(struct omap_scanout *so, WindowPtr window)
+{
+	so->window = window;
+	so->pixmap = so->screen->GetWindowPixmap(window);
+	so->pixmap->refcnt++;
+	so->shown = TRUE;
+
+	set_prop(so, omap_video_show_lent_plane(so->fbdev, so->plane, TRUE));
+
+	/* Manual-update panels only show planes where we push updates. */
+	if (so->fbdev->update) {
+		so->damage = DamageCreate(NULL, NULL, DamageReportNone, TRUE,
+					  so->screen, so);
+		if (so->damage)
+			DamageRegister(&so->pixmap->drawable, so->damage);
+		omap_update_add(so->fbdev, NULL);
+	}
+
+	DebugF("omap/scanout: window 0x%lx on plane %d\n",
+	       (unsigned long)window->drawable.id, so->plane);
+}
+
+static void hide(struct omap_scanout *so)
+{
+	if (!so->shown)
+		return;
+
+	omap_video_show_lent_plane(so->fbdev, so->plane, FALSE);
+	set_prop(so, 0);
+
+	if (so->damage) {
+		DamageUnregister(&so->pixmap->drawable, so->damage);
+		DamageDestroy(so->damage);
+		so->damage = NULL;
+	}
+	omap_update_add(so->fbdev, NULL);
+
+	so->shown = FALSE;
+	so->window = NULL;
+	so->screen->DestroyPixmap(so->pixmap);
+	so->pixmap = NULL;
+
+	DebugF("omap/scanout: plane %d hidden\n", so->plane);
+}
+
+static Bool covers_screen(ScreenPtr screen, WindowPtr window)
+{
+	return window->drawable.x == 0 && window->drawable.y == 0 &&
+	    window->drawable.width == screen->width &&
+	    window->drawable.height == screen->height;
+}
+
+/* Only unrotated: the plane is scanned out as the pixmap is laid out. */
+static Bool unrotated(struct omap_scanout *so)
+{
+	xf86CrtcPtr crtc = so->fbdev->crtc_lcd;
+
+	return !crtc || (crtc->rotation & 0xf) == RR_Rotate_0;
+}
+
+/**
+ * The window to scan out: the top-level one backed by our pixmap, if it
+ * covers the screen and only unredirected windows, which are drawn to
+ * the frame buffer around the colour key, are above it.
+ */
+static WindowPtr find_window(struct omap_scanout *so)
+{
+	ScreenPtr screen = so->screen;
+	WindowPtr window;
+	PixmapPtr pixmap;
+
+	if (!so->ppix || !unrotated(so))
+		return NULL;
+
+	for (window = WindowTable[screen->myNum]->firstChild; window;
+	     window = window->nextSib) {
+		if (!window->viewable || window->drawable.class == InputOnly)
+			continue;
+
+		pixmap = screen->GetWindowPixmap(window);
+		if (exaGetPixmapDriverPrivate(pixmap) == so->ppix)
+			return covers_screen(screen, window) ? window : NULL;
+		if (pixmap != screen->GetScreenPixmap(screen))
+			return NULL;
+	}
+
+	return NULL;
+}
+
+static void scanout_block_handler(int i, pointer blockData, pointer pTimeout,
+				  pointer pReadmask)
+{
+	ScreenPtr screen = screenInfo.screens[i];
+	struct omap_scanout *so = scanout;
+	WindowPtr window;
+
+	/* Before omap/update's handler, so our damage goes out with it. */
+	window = find_window(so);
+	if (window != so->window) {
+		hide(so);
+		if (window)
+			show(so, window);
+	} else if (so->damage &&
+		   REGION_NOTEMPTY(screen, DamageRegion(so->damage))) {
+		omap_update_add(so->fbdev,
+				REGION_EXTENTS(screen,
+					       DamageRegion(so->damage)));
+		DamageEmpty(so->damage);
+	}
+
+	screen->BlockHandler = so->block_handler;
+	(*screen->BlockHandler) (i, blockData, pTimeout, pReadmask);
+	screen->BlockHandler = scanout_block_handler;
+}
+
+/* Video wants the plane back. */
+static void scanout_reclaim(pointer data)
+{
+	struct omap_scanout *so = data;
+
+	if (so->ppix)
+		omap_scanout_evict(so->ppix);
+	else
+		/* Its memory is waiting on the GPU. */
+		PVR2DDelayedMemDestroy(TRUE);
+}
+
+Bool omap_scanout_alloc(ScreenPtr screen, struct PVR2DPixmap *ppix,
+			int width, int height, int depth, int bpp, int pitch)
+{
+	struct omap_scanout *so = scanout;
+	unsigned long phys, *pages;
+	int plane, plane_pitch, num_pages, i, page_size = getpagesize();
+	PVR2DERROR err;
+	CARD8 *mem;
+
+	if (!so || so->screen != screen || so->plane >= 0 || !unrotated(so))
+		return FALSE;
+	if (width != screen->width || height != screen->height)
+		return FALSE;
+	if (!(depth == 16 && bpp == 16) && !(depth == 24 && bpp == 32))
+		return FALSE;
+
+	plane = omap_video_lend_plane(so->fbdev, width, height, bpp, FALSE,
+				      scanout_reclaim, so, &mem, &phys,
+				      &plane_pitch);
+	if (plane < 0)
+		return FALSE;
+
+	/* SGX and the plane have to agree on the layout. */
+	if (plane_pitch != pitch)
+		goto fail;
+
+	num_pages = (pitch * height + page_size - 1) / page_size;
+	pages = xcalloc(num_pages, sizeof(*pages));
+	if (!pages)
+		goto fail;
+	for (i = 0; i < num_pages; i++)
+		pages[i] = phys + i * page_size;
+
+	err = PVR2DMemWrap(hPVR2DContext, mem, PVR2D_WRAPFLAG_CONTIGUOUS,
+			   pitch * height, pages, &ppix->pvr2dmem);
+	xfree(pages);
+	if (err != PVR2D_OK) {
+		ppix->pvr2dmem = NULL;
+		goto fail;
+	}
+
+	ppix->shmaddr = mem;
+	ppix->shmid = -1;
+	ppix->scanout = plane + 1;
+	so->ppix = ppix;
+	so->plane = plane;
+
+	return TRUE;
+
+fail:
+	omap_video_return_plane(so->fbdev, plane);
+	return FALSE;
+}
+
+void omap_scanout_forget(struct PVR2DPixmap *ppix)
+{
+	struct omap_scanout *so = scanout;
+
+	if (!so || !ppix || so->ppix != ppix)
+		return;
+
+	hide(so);
+	so->ppix = NULL;
+}
+
+void omap_scanout_free(int plane)
+{
+	struct omap_scanout *so = scanout;
+
+	if (!so || so->plane != plane)
+		return;
+
+	omap_video_return_plane(so->fbdev, plane);
+	so->plane = -1;
+}
+
+Bool omap_scanout_evict(struct PVR2DPixmap *ppix)
+{
+	struct PVR2DPixmap old;
+
+	if (!ppix->scanout)
+		return TRUE;
+
+	if (QueryBlitsComplete(ppix, 1) != PVR2D_OK)
+		return FALSE;
+
+	old = *ppix;
+	ppix->pvr2dmem = NULL;
+	ppix->shmaddr = NULL;
+	ppix->scanout = 0;
+	if (!PVR2DAllocSHM(ppix)) {
+		*ppix = old;
+		return FALSE;
+	}
+
+	omap_scanout_forget(ppix);
+	memcpy(ppix->shmaddr, old.shmaddr, old.shmsize);
+	ppix->owner = PVR2D_OWNER_CPU;
+	ppix->bCPUWrites = TRUE;
+
+	DestroyPVR2DMemory(&old);
+
+	return TRUE;
+}
+
+
+void omap_scanout_drawable_destroyed(DrawablePtr drawable)
+{
+	struct omap_scanout *so = scanout;
+
+	if (!so || !so->window || &so->window->drawable != drawable)
+		return;
+
+	/* No property to reset on a window that's going away. */
+	so->window = NULL;
+	hide(so);
+}
+
+Bool omap_scanout_init(ScreenPtr screen)
+{
+	FBDevPtr fbdev = FBDEVPTR(xf86Screens[screen->myNum]);
+	struct omap_scanout *so;
+
+	if (scanout || !fbdev->overlay_adaptor)
+		return FALSE;
+
+	so = xcalloc(1, sizeof(*so));
+	if (!so)
+		return FALSE;
+
+	so->screen = screen;
+	so->fbdev = fbdev;
+	so->prop = MAKE_ATOM(SCANOUT_PROP_NAME);
+	so->plane = -1;
+
+	so->block_handler = screen->BlockHandler;
+	screen->BlockHandler = scanout_block_handler;
+	scanout = so;
+
+	return TRUE;
+}
+
+void omap_scanout_fini(ScreenPtr screen)
+{
+	struct omap_scanout *so = scanout;
+
+	if (!so || so->screen != screen)
+		return;
+
+	if (screen->BlockHandler == scanout_block_handler)
+		screen->BlockHandler = so->block_handler;
+
+	hide(so);
+	if (so->ppix)
+		so->ppix->scanout = 0;
+	if (so->plane >= 0)
+		omap_video_return_plane(so->fbdev, so->plane);
+
+	xfree(so);
+	scanout = NULL;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OMAP_SCANOUT_H
+#define OMAP_SCANOUT_H
+
+#include "fbdev.h"
+
+struct PVR2DPixmap;
+
+/*
+ * Fullscreen windows scanned out straight from their composite backing
+ * pixmap, which lives in a spare video plane for that purpose.
+ */
+Bool omap_scanout_init(ScreenPtr screen);
+void omap_scanout_fini(ScreenPtr screen);
+
+/**
+ * Back ppix with a video plane, if it could be scanned out.  Called
+ * instead of allocating SHM for backing pixmaps.
+ */
+Bool omap_scanout_alloc(ScreenPtr screen, struct PVR2DPixmap *ppix,
+			int width, int height, int depth, int bpp, int pitch);
+/* ppix's memory is about to go away. */
+void omap_scanout_forget(struct PVR2DPixmap *ppix);
+/* Its memory is gone; give the plane back. */
+void omap_scanout_free(int plane);
+/* Move ppix's contents out of the plane, into SHM. */
+Bool omap_scanout_evict(struct PVR2DPixmap *ppix);
+
+void omap_scanout_drawable_destroyed(DrawablePtr drawable);
+
+#endif
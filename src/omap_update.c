@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Damage-driven updates for manual-update panels.
+ *
+ * Panels behind an external controller (OMAPFB_CAPS_MANUAL_UPDATE) only
+ * show what gets pushed to them with OMAPFB_UPDATE_WINDOW.  Left in auto
+ * update mode, the kernel pushes the whole screen on a timer; instead we
+ * track damage to the screen pixmap, merge it into a few rectangles and
+ * push only those, at most once per refresh.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+#include <sys/ioctl.h>
+#include <string.h>
+#include <linux/omapfb.h>
+
+#include "exa.h"
+#include "omap_damage.h"
+#include "omap_update.h"
+#include "omap_hold.h"
+#include "sgx_rotate.h"
+
+/* Rectangles pushed per update; each costs a controller setup. */
+#define UPDATE_MAX_RECTS 4
+
+struct omap_update {
+	ScreenPtr screen;
+	int fd;
+	enum omapfb_color_format format;
+	int saved_mode;
+
+	struct omap_damage track;
+	RegionRec pending;
+
+	/* Pacing, in milliseconds. */
+	CARD32 interval;
+	CARD32 last;
+	OsTimerPtr timer;
+	Bool scheduled;
+
+	void (*block_handler) (int, pointer, pointer, pointer);
+};
+
+static int box_area(BoxPtr box)
+{
+	return (box->x2 - box->x1) * (box->y2 - box->y1);
+}
+
+/**
+ * Reduce region to at most UPDATE_MAX_RECTS boxes by repeatedly merging
+ * the pair whose bounding box adds the least area.
+ */
+static int coalesce(struct omap_update *update, RegionPtr region,
+		    BoxPtr boxes)
+{
+	int i, j, bi, bj = 0, cost, best = 0, n;
+	BoxPtr rects;
+	BoxRec u;
+
+	n = omap_damage_boxes(update->screen, region, &rects);
+	memcpy(boxes, rects, n * sizeof(BoxRec));
+
+	while (n > UPDATE_MAX_RECTS) {
+		bi = -1;
+		for (i = 0; i < n; i++) {
+			for (j = i + 1; j < n; j++) {
+				u.x1 = min(boxes[i].x1, boxes[j].x1);
+				u.y1 = min(boxes[i].y1, boxes[j].y1);
+				u.x2 = max(boxes[i].x2, boxes[j].x2);
+				u.y2 = max(boxes[i].y2, boxes[j].y2);
+				cost = box_area(&u) - box_area(&boxes[i]) -
+				    box_area(&boxes[j]);
+				if (bi < 0 || cost < best) {
+					best = cost;
+					bi = i;
+					bj = j;
+				}
+			}
+		}
+
+		boxes[bi].x1 = min(boxes[bi].x1, boxes[bj].x1);
+		boxes[bi].y1 = min(boxes[bi].y1, boxes[bj].y1);
+		boxes[bi].x2 = max(boxes[bi].x2, boxes[bj].x2);
+		boxes[bi].y2 = max(boxes[bi].y2, boxes[bj].y2);
+		boxes[bj] = boxes[--n];
+	}
+
+	return n;
+}
+
+static void collect(struct omap_update *update)
+{
+	FBDevPtr fbdev = FBDEVPTR(xf86Screens[update->screen->myNum]);
+
+	/* Whatever was on a new pixmap before is stale. */
+	if (!omap_damage_track(&update->track, NULL, TRUE))
+		return;
+
+	/* When the SGX rotates, what it copies is added in panel
+	 * coordinates instead. */
+	if (!sgx_rotate_active(fbdev))
+		REGION_UNION(update->screen, &update->pending,
+			     &update->pending,
+			     DamageRegion(update->track.damage));
+	DamageEmpty(update->track.damage);
+}
+
+static void flush(struct omap_update *update)
+{
+	ScreenPtr screen = update->screen;
+	FBDevPtr fbdev = FBDEVPTR(xf86Screens[screen->myNum]);
+	struct omapfb_update_window update_window;
+	BoxRec boxes[OMAP_DAMAGE_MERGE_LIMIT], bounds;
+	RegionRec clip;
+	int i, n;
+
+	collect(update);
+	if (!update->track.pixmap ||
+	    !REGION_NOTEMPTY(screen, &update->pending))
+		return;
+
+	/* Keep it for when the panel is back on. */
+	if (!omap_output_visible(fbdev, NULL))
+		return;
+
+	bounds.x1 = 0;
+	bounds.y1 = 0;
+	if (sgx_rotate_active(fbdev)) {
+		bounds.x2 = fbdev->builtin->HDisplay;
+		bounds.y2 = fbdev->builtin->VDisplay;
+	} else {
+		bounds.x2 = update->track.pixmap->drawable.width;
+		bounds.y2 = update->track.pixmap->drawable.height;
+	}
+	REGION_INIT(screen, &clip, &bounds, 1);
+	REGION_INTERSECT(screen, &update->pending, &update->pending, &clip);
+	REGION_UNINIT(screen, &clip);
+
+	n = coalesce(update, &update->pending, boxes);
+	REGION_EMPTY(screen, &update->pending);
+	update->last = GetTimeInMillis();
+
+	/* The controller reads the frame buffer, so rendering to it has to
+	 * be done first. */
+	exaWaitSync(screen);
+
+	memset(&update_window, 0, sizeof update_window);
+	update_window.format = update->format;
+
+	for (i = 0; i < n; i++) {
+		update_window.x = update_window.out_x = boxes[i].x1;
+		update_window.y = update_window.out_y = boxes[i].y1;
+		update_window.width = update_window.out_width =
+		    boxes[i].x2 - boxes[i].x1;
+		update_window.height = update_window.out_height =
+		    boxes[i].y2 - boxes[i].y1;
+
+		/* This fails when the screen's off, so ignore it. */
+		(void)ioctl(update->fd, OMAPFB_UPDATE_WINDOW, &update_window);
+	}
+}
+
+static CARD32 update_timer(OsTimerPtr timer, CARD32 now, pointer data)
+{
+	struct omap_update *update = data;
+
+	update->scheduled = FALSE;
+	flush(update);
+
+	return 0;
+}
+
+/**
+ * Push new damage right away if the last update was at least a refresh
+ * ago, otherwise once it is.
+ */
+static void update_block_handler(int i, pointer blockData, pointer pTimeout,
+				 pointer pReadmask)
+{
+	ScreenPtr screen = screenInfo.screens[i];
+	struct omap_update *update = FBDEVPTR(xf86Screens[i])->update;
+	CARD32 elapsed;
+
+	screen->BlockHandler = update->block_handler;
+	(*screen->BlockHandler) (i, blockData, pTimeout, pReadmask);
+	screen->BlockHandler = update_block_handler;
+
+	if (update->scheduled)
+		return;
+
+	collect(update);
+	if (!REGION_NOTEMPTY(screen, &update->pending))
+		return;
+
+	elapsed = GetTimeInMillis() - update->last;
+	if (elapsed >= update->interval) {
+		flush(update);
+	} else {
+		update->timer = TimerSet(update->timer, 0,
+					 update->interval - elapsed,
+					 update_timer, update);
+		update->scheduled = TRUE;
+	}
+}
+
+void omap_update_add(FBDevPtr fbdev, BoxPtr box)
+{
+	struct omap_update *update = fbdev->update;
+	ScreenPtr screen;
+	RegionRec region;
+	BoxRec all;
+
+	if (!update)
+		return;
+	screen = update->screen;
+
+	/* flush() clips to the screen pixmap as it is by then. */
+	if (!box) {
+		all.x1 = 0;
+		all.y1 = 0;
+		all.x2 = MAXSHORT;
+		all.y2 = MAXSHORT;
+		box = &all;
+	}
+
+	REGION_INIT(screen, &region, box, 1);
+	REGION_UNION(screen, &update->pending, &update->pending, &region);
+	REGION_UNINIT(screen, &region);
+}
+
+Bool omap_update_init(ScreenPtr screen)
+{
+	ScrnInfoPtr pScrn = xf86Screens[screen->myNum];
+	FBDevPtr fbdev = FBDEVPTR(pScrn);
+	struct omap_update *update;
+	struct omapfb_caps caps;
+	int mode = OMAPFB_MANUAL_UPDATE;
+	CARD32 refresh_us = omap_output_refresh_us(fbdev);
+
+	if (ioctl(fbdev->fd, OMAPFB_GET_CAPS, &caps) != 0 ||
+	    !(caps.ctrl & OMAPFB_CAPS_MANUAL_UPDATE))
+		return FALSE;
+
+	update = xcalloc(1, sizeof(*update));
+	if (!update)
+		return FALSE;
+
+	update->screen = screen;
+	update->fd = fbdev->fd;
+	update->format = pScrn->bitsPerPixel == 16 ?
+	    OMAPFB_COLOR_RGB565 : OMAPFB_COLOR_RGB24U;
+	if (ioctl(update->fd, OMAPFB_GET_UPDATE_MODE, &update->saved_mode))
+		update->saved_mode = OMAPFB_AUTO_UPDATE;
+
+	update->interval = refresh_us / 1000;
+
+	if (!omap_damage_init(&update->track, screen))
+		goto fail;
+
+	/* From here on the panel only shows what we push. */
+	if (ioctl(update->fd, OMAPFB_SET_UPDATE_MODE, &mode) != 0) {
+		ErrorF("omap/update: couldn't set manual update mode, "
+		       "leaving updates to the kernel\n");
+		omap_damage_fini(&update->track);
+		goto fail;
+	}
+
+	REGION_NULL(screen, &update->pending);
+	update->block_handler = screen->BlockHandler;
+	screen->BlockHandler = update_block_handler;
+	fbdev->update = update;
+
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		   "Manual update panel, pushing damage at %d Hz\n",
+		   (int)(1000000 / refresh_us));
+
+	return TRUE;
+
+fail:
+	xfree(update);
+	return FALSE;
+}
+
+void omap_update_fini(ScreenPtr screen)
+{
+	FBDevPtr fbdev = FBDEVPTR(xf86Screens[screen->myNum]);
+	struct omap_update *update = fbdev->update;
+
+	if (!update)
+		return;
+
+	if (screen->BlockHandler == update_block_handler)
+		screen->BlockHandler = update->block_handler;
+
+	TimerFree(update->timer);
+	omap_damage_fini(&update->track);
+	REGION_UNINIT(screen, &update->pending);
+
+	(void)ioctl(update->fd, OMAPFB_SET_UPDATE_MODE, &update->saved_mode);
+
+	xfree(update);
+	fbdev->update = NULL;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OMAP_UPDATE_H
+#define OMAP_UPDATE_H
+
+#include "fbdev.h"
+
+/**
+ * Take over updates of a manual-update panel.  Returns FALSE, leaving
+ * them to the kernel, if the panel updates itself or can't be switched.
+ */
+Bool omap_update_init(ScreenPtr screen);
+void omap_update_fini(ScreenPtr screen);
+
+/**
+ * Push box (in frame buffer coordinates; NULL for all of it) with the
+ * next update, on top of whatever the screen pixmap's damage says.
+ */
+void omap_update_add(FBDevPtr fbdev, BoxPtr box);
+
+#endif
@@ -28,6 +28,9 @@
 #include <linux/fb.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <signal.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
@@ -44,17 +47,29 @@
 #include "omap_video.h"
 #include "omap_video_formats.h"
 #include "omap_tvout.h"
-#include "omap_procfs.h"
+#include "omap_hold.h"
+#include "omap_scanout.h"
+#include "omap_vram.h"
+#include "sgx_exa.h"
 #include "sgx_xv.h"
 
+#define OMAP_MAX_FLIP_BUFFERS 4
+
 struct omap_video_info {
 	/* Immutable port/plane properties. */
 	int id;
 	int fd;
+	/* The plane's mapping, which outlives stops and restarts as long as
+	 * the memory behind it stays put; mem is the frame buffer within. */
+	CARD8 *map;
 	CARD8 *mem;
 	int mem_size;
+	unsigned long mem_start;
+	CARD32 maps, unmaps;
 	unsigned long caps;
 	int manual_updates;
+	/* The plane takes OMAPFB_COLOR_YUV420. */
+	int yuv420_caps;
 
 	/* Mutable video properties. */
 	int dirty;
@@ -62,6 +77,8 @@ struct omap_video_info {
 	DrawablePtr drawable;
 	unsigned int visibility;
 	RegionRec clip;
+	/* Drawable origin when clip was taken. */
+	short clip_x, clip_y;
 	Pixel ckey;
 	int autopaint_ckey;
 	int disable_ckey;
@@ -78,9 +95,16 @@ struct omap_video_info {
 	} state;
 
 	int fourcc;
-	short src_w, src_h;
+	short src_x, src_y, src_w, src_h;
 	short dst_x, dst_y, dst_w, dst_h, dst_pitch;
 	int hscale, vscale;
+	enum omap_scale_filter scale_filter;
+	/* Feed planar video to the plane as YUV420 where possible. */
+	int native_yuv420;
+	/* The plane is currently set up as YUV420. */
+	int yuv420;
+	/* Screen rotation the plane contents are converted for. */
+	Rotation rotation;
 
 	/* Internal bits. */
 
@@ -93,7 +117,40 @@ struct omap_video_info {
 	int overlay_active;
 
 	struct fb_var_screeninfo var;
-	int double_buffer;
+
+	/* Flipping: num_buffers is what the client asked for, buffers what
+	 * fit in memory.  back is the buffer the next frame goes to, and
+	 * retired[] holds when each buffer was last panned away from. */
+	int num_buffers;
+	int buffers;
+	int front, back;
+	CARD32 retired[OMAP_MAX_FLIP_BUFFERS];
+	CARD32 frame_us;
+
+	/* Flipped planes hand each converted frame to a worker through a
+	 * one-frame mailbox; a newer frame replaces one not yet shown. */
+	int async;
+	struct omap_present {
+		Bool running, quit;
+		pthread_t thread;
+		pthread_mutex_t lock;
+		pthread_cond_t cond;
+		int pending;		/* Buffer in the mailbox, or -1. */
+		int busy;		/* Buffer being flipped to, or -1. */
+		CARD32 queued;		/* When pending was posted. */
+		CARD32 frames, dropped, latency_us;
+	} present;
+
+	/* Set while the plane is lent to a port of the auto adaptor. */
+	struct omap_auto_port *borrower;
+	/* Set while the plane is lent out, see omap_video_lend_plane(). */
+	Bool lent;
+	Bool alpha;
+	void (*reclaim) (pointer data);
+	pointer reclaim_data;
+
+	/* Latest frame put while it couldn't be seen. */
+	struct omap_hold hold;
 };
 #define get_omap_video_info(fbdev, n) ((fbdev)->overlay_adaptor->pPortPrivates[n].ptr)
 
@@ -113,17 +170,30 @@ static XF86AttributeRec xv_attributes[] = {
 	{XvSettable | XvGettable, 0, 1, "XV_AUTOPAINT_COLORKEY"},
 	{XvSettable | XvGettable, 0, 1, "XV_DISABLE_COLORKEY"},
 	{XvSettable | XvGettable, 0, 1, "XV_DOUBLE_BUFFER"},
+	{XvSettable | XvGettable, 1, OMAP_MAX_FLIP_BUFFERS, "XV_OMAP_BUFFERS"},
 	{XvSettable | XvGettable, 0, 1, "XV_OMAP_CLONE_TO_TVOUT"},
 	{XvSettable | XvGettable, 0, 1, "XV_OMAP_TVOUT_STANDARD"},
 	{XvSettable | XvGettable, 0, 1, "XV_OMAP_TVOUT_WIDESCREEN"},
 	{XvSettable | XvGettable, 1, 100, "XV_OMAP_TVOUT_SCALE"},
 	{XvGettable, 0, 1, "XV_OMAP_OVERLAY_ACTIVE"},
+	{XvSettable | XvGettable, OMAP_SCALE_NEAREST, OMAP_SCALE_BOX,
+	 "XV_OMAP_SCALE_FILTER"},
+	{XvSettable | XvGettable, 0, 1, "XV_OMAP_NATIVE_YUV420"},
+	{XvSettable | XvGettable, 0, 1, "XV_OMAP_ASYNC"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_FRAMES"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_DROPPED_FRAMES"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_QUEUE_LATENCY"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_MAPS"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_UNMAPS"},
 };
 
 static Atom xv_ckey, xv_autopaint_ckey, xv_disable_ckey, xv_vsync;
 static Atom xv_omap_clone_to_tvout, xv_omap_tvout_standard;
 static Atom xv_omap_tvout_widescreen, xv_omap_tvout_scale;
-static Atom xv_omap_overlay_active, xv_double_buffer;
+static Atom xv_omap_overlay_active, xv_double_buffer, xv_omap_buffers;
+static Atom xv_omap_scale_filter, xv_omap_native_yuv420;
+static Atom xv_omap_async, xv_omap_frames, xv_omap_dropped_frames;
+static Atom xv_omap_queue_latency, xv_omap_maps, xv_omap_unmaps;
 
 static Atom _omap_video_overlay;	/* Window property, not Xv property. */
 
@@ -147,6 +217,7 @@ static struct {
 #define OMAP_YV12_PITCH_LUMA(w)   (((w) + 3) & ~3)
 #define OMAP_YV12_PITCH_CHROMA(w) (((OMAP_YV12_PITCH_LUMA(w) >> 1) + 3) & ~3)
 #define OMAP_YUY2_PITCH(w)        ((((w) + 1) & ~1) << 1)
+#define OMAP_YUV420_PITCH(w)      ((((w) + 3) & ~3) * 3 / 2)
 #define OMAP_RV16_PITCH(w)        ((w) << 1)
 #define OMAP_RV32_PITCH(w)        ((w) << 2)
 
@@ -155,7 +226,6 @@ static struct {
  * size which can fit in our video memory.
  */
 enum {
-	MAX_PLANES          = 2,
 	MAX_BUFFERS         = 2,
 	MAX_BYTES_PER_PIXEL = 2,
 };
@@ -168,15 +238,30 @@ static void sync_gfx(FBDevPtr fbdev)
 	ioctl(fbdev->fd, OMAPFB_SYNC_GFX);
 }
 
+static CARD32 now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (CARD32) tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
 static enum omapfb_color_format get_omapfb_format(struct omap_video_info
 						  *video_info)
 {
 	int i;
 
+	if (video_info->fourcc == FOURCC_RV32 && video_info->alpha)
+		return OMAPFB_COLOR_ARGB32;
+
 	if (video_info->fourcc == FOURCC_RV16 ||
 	    video_info->fourcc == FOURCC_RV32)
 		return 0;
 
+	if (video_info->yuv420)
+		return OMAPFB_COLOR_YUV420;
+
 	for (i = 0; i < ARRAY_SIZE(video_format_map); i++) {
 		if (video_format_map[i].xv_format.id == video_info->fourcc) {
 			return video_format_map[i].omapfb_format;
@@ -218,6 +303,11 @@ static unsigned int calc_required_mem(struct omap_video_info *video_info)
 	switch (video_info->fourcc) {
 	case FOURCC_YV12:
 	case FOURCC_I420:
+		if (video_info->yuv420) {
+			ret = OMAP_YUV420_PITCH(src_w) * src_h;
+			break;
+		}
+		/* fall through */
 	case FOURCC_YUY2:
 	case FOURCC_UYVY:
 		ret = OMAP_YUY2_PITCH(src_w) * src_h;
@@ -230,49 +320,136 @@ static unsigned int calc_required_mem(struct omap_video_info *video_info)
 		break;
 	}
 
-	return ret << video_info->double_buffer;
+	return ret * video_info->buffers;
 }
 
-static unsigned int get_mem_size(struct omap_video_info *video_info)
+static void omap_video_modify_encoding(FBDevPtr fbdev)
 {
-	struct omapfb_mem_info mem_info;
+	unsigned int vram, max_w, max_h;
 
-	if (ioctl(video_info->fd, OMAPFB_QUERY_MEM, &mem_info) != 0)
-		return 0;
+	ENTER();
+
+	/* Calculate the max image size (of a certain aspect ratio) which will
+	 * fit into the memory one plane can get. */
+	vram = omap_vram_budget(fbdev->vram);
+	vram -= vram % getpagesize();
+	vram /= MAX_BYTES_PER_PIXEL * MAX_BUFFERS;
+
+	/* Try 16:9 first. */
+	max_h = sqrt(9 * vram / 16);
+	max_w = 16 * max_h / 9;
+
+	/* Only use 16:9 if 720p is possible, otherwise fall back to 4:3. */
+	if (max_w < 1280 || max_h < 720) {
+		max_h = sqrt(3 * vram / 4);
+		max_w = 4 * max_h / 3;
+	}
+
+	/* Hardware limits */
+	if (max_w > VIDEO_IMAGE_MAX_WIDTH) {
+		max_h =
+		    min(VIDEO_IMAGE_MAX_WIDTH, vram / VIDEO_IMAGE_MAX_WIDTH);
+		max_w = VIDEO_IMAGE_MAX_WIDTH;
+	}
+	if (max_h > VIDEO_IMAGE_MAX_HEIGHT) {
+		max_h = VIDEO_IMAGE_MAX_HEIGHT;
+		max_w =
+		    min(VIDEO_IMAGE_MAX_HEIGHT, vram / VIDEO_IMAGE_MAX_HEIGHT);
+	}
+
+	/* Only full macropixels */
+	max_w &= ~1;
+
+	DummyEncoding.width = max_w;
+	DummyEncoding.height = max_h;
+
+	LEAVE();
+}
+
+/**
+ * Work out whether the plane needs software scaling for the given sizes:
+ * dispc only downscales so far and upscales up to 8x.
+ */
+static void calc_scaling(int src_w, int src_h, int dst_w, int dst_h,
+			 int *hscale, int *vscale)
+{
+	int maxvdownscale = src_w > 1024 ? 2 : 4;
 
-	return mem_info.size;
+	*hscale = src_w > dst_w * 4 || src_w * 8 < dst_w;
+	*vscale = src_h > dst_h * maxvdownscale || src_h * 8 < dst_h;
 }
 
-static int alloc_plane_mem(struct omap_video_info *video_info,
-			   unsigned int size)
+enum plane_change {
+	PLANE_UNCHANGED,
+	PLANE_MOVED,		/* Output position only. */
+	PLANE_RESIZED,		/* Output size, and maybe position. */
+	PLANE_CHANGED,		/* Source, format or scaling: full setup. */
+};
+
+/**
+ * Check how the plane attributes have changed.  Only changes to what is
+ * in the plane's memory need a full setup; the rest is the output window.
+ */
+static enum plane_change plane_change(struct omap_video_info *video_info,
+				      int fourcc, int src_w, int src_h,
+				      int dst_x, int dst_y, int dst_w,
+				      int dst_h, Rotation rotation)
 {
-	struct omapfb_mem_info mem_info;
+	int hscale, vscale;
 
-	/* Not everyone has (enough) SRAM, and allocating into SRAM usually
-	 * ends very badly anyway (kernel bugs), so we hardcode SDRAM here. */
-	mem_info.type = OMAPFB_MEMTYPE_SDRAM;
-	mem_info.size = size;
+	if (video_info->dirty || !video_info->mem
+	    || video_info->fourcc != fourcc
+	    || video_info->rotation != rotation
+	    || video_info->src_w != src_w || video_info->src_h != src_h)
+		return PLANE_CHANGED;
 
-	if (ioctl(video_info->fd, OMAPFB_SETUP_MEM, &mem_info) != 0)
-		return 0;
+	if (video_info->dst_w != dst_w || video_info->dst_h != dst_h) {
+		/* Software-scaled frames are sized for the output. */
+		calc_scaling(src_w, src_h, dst_w, dst_h, &hscale, &vscale);
+		if (hscale || vscale || video_info->hscale
+		    || video_info->vscale)
+			return PLANE_CHANGED;
 
-	return 1;
+		return PLANE_RESIZED;
+	}
+
+	if (video_info->dst_x != dst_x || video_info->dst_y != dst_y)
+		return PLANE_MOVED;
+
+	return PLANE_UNCHANGED;
 }
 
 /**
- * Check if plane attributes have changed.
+ * A put that redraws part of what the unscaled, unrotated plane already
+ * shows, at the same position and scale, only needs that part converted
+ * into the plane as it stands.
  */
-static _X_INLINE int is_dirty(struct omap_video_info *video_info, int fourcc,
-			      int src_w, int src_h, int dst_x, int dst_y,
-			      int dst_w, int dst_h)
-{
-	if (video_info->dirty || video_info->fourcc != fourcc
-	    || video_info->src_w != src_w || video_info->src_h != src_h
-	    || video_info->dst_x != dst_x || video_info->dst_y != dst_y
-	    || video_info->dst_w != dst_w || video_info->dst_h != dst_h)
-		return 1;
-	else
-		return 0;
+static Bool is_partial(struct omap_video_info *video_info, int fourcc,
+		       Rotation rotation, DrawablePtr drawable, int src_x,
+		       int src_y, int src_w, int src_h, int dst_x, int dst_y,
+		       int dst_w, int dst_h)
+{
+	if (!video_info->mem || video_info->dirty
+	    || video_info->fourcc != fourcc || video_info->drawable != drawable
+	    || rotation != RR_Rotate_0 || video_info->hscale
+	    || video_info->vscale || video_info->buffers > 1
+	    || video_info->yuv420)
+		return FALSE;
+
+	if (src_w == video_info->src_w && src_h == video_info->src_h)
+		return FALSE;
+
+	if (src_x < video_info->src_x || src_y < video_info->src_y
+	    || src_x + src_w > video_info->src_x + video_info->src_w
+	    || src_y + src_h > video_info->src_y + video_info->src_h)
+		return FALSE;
+
+	return (dst_x - video_info->dst_x) * video_info->src_w ==
+	    (src_x - video_info->src_x) * video_info->dst_w
+	    && (dst_y - video_info->dst_y) * video_info->src_h ==
+	    (src_y - video_info->src_y) * video_info->dst_h
+	    && dst_w * video_info->src_w == src_w * video_info->dst_w
+	    && dst_h * video_info->src_h == src_h * video_info->dst_h;
 }
 
 /**
@@ -333,6 +510,41 @@ static Bool clip_image_to_fit(short *src_x, short *src_y, short *dst_x,
 	return TRUE;
 }
 
+/**
+ * Map a box from screen coordinates to the unrotated panel, which is what
+ * plane positions are relative to.
+ */
+static void rotate_box(FBDevPtr fbdev, Rotation rotation, short *x, short *y,
+		       short *w, short *h)
+{
+	int panel_w = fbdev->builtin->HDisplay;
+	int panel_h = fbdev->builtin->VDisplay;
+	short t;
+
+	switch (rotation) {
+	case RR_Rotate_90:
+		t = *x;
+		*x = *y;
+		*y = panel_h - (t + *w);
+		break;
+	case RR_Rotate_180:
+		*x = panel_w - (*x + *w);
+		*y = panel_h - (*y + *h);
+		return;
+	case RR_Rotate_270:
+		t = *y;
+		*y = *x;
+		*x = panel_w - (t + *h);
+		break;
+	default:
+		return;
+	}
+
+	t = *w;
+	*w = *h;
+	*h = t;
+}
+
 static CARD32 default_ckey(ScrnInfoPtr pScrn)
 {
 	return (((0x00 << pScrn->offset.red) & pScrn->mask.red) |
@@ -409,23 +621,49 @@ static void set_ckey_timer(struct omap_video_info *video_info)
 					  ckey_timer, video_info);
 }
 
+static void unmap_plane(struct omap_video_info *video_info)
+{
+	if (video_info->map) {
+		munmap(video_info->map, video_info->mem_size +
+		       (video_info->mem - video_info->map));
+		video_info->unmaps++;
+	}
+
+	video_info->map = NULL;
+	video_info->mem = NULL;
+	video_info->mem_size = 0;
+	video_info->mem_start = 0;
+	video_info->dst_pitch = 0;
+}
+
 /**
- * Sets up a video plane.
+ * Sets up a video plane.  Memory left over from the last setup is kept,
+ * mapped, as long as it is big enough.
  */
 static int setup_plane(struct omap_video_info *video_info)
 {
+	struct omap_vram *vram = video_info->fbdev->vram;
 	struct fb_var_screeninfo var;
 	struct fb_fix_screeninfo fix;
 	struct omapfb_plane_info plane_info;
 	unsigned int src_w, src_h, dst_w, dst_h;
+	int i;
 
-	/* Do we need to reallocate? */
-	if (get_mem_size(video_info) != calc_required_mem(video_info)) {
-		if (!alloc_plane_mem(video_info, calc_required_mem(video_info))) {
+	/* Do we need to grow?  Settle for fewer buffers if all the requested
+	 * ones don't fit. */
+	video_info->buffers = video_info->num_buffers;
+	while (!omap_vram_fits(vram, video_info->id,
+			       calc_required_mem(video_info))) {
+		unmap_plane(video_info);
+		if (omap_vram_reserve(vram, video_info->id,
+				      calc_required_mem(video_info)))
+			break;
+		if (video_info->buffers == 1) {
 			ErrorF
 			    ("omap/video: couldn't allocate memory for video plane!\n");
 			goto unwind_start;
 		}
+		video_info->buffers--;
 	}
 
 	/* Hilariously, this will actually trigger upscaling for odd widths,
@@ -449,6 +687,8 @@ static int setup_plane(struct omap_video_info *video_info)
 	switch (video_info->fourcc) {
 	case FOURCC_YV12:
 	case FOURCC_I420:
+		src_w &= video_info->yuv420 ? ~3 : ~1;
+		break;
 	case FOURCC_YUY2:
 	case FOURCC_UYVY:
 		src_w &= ~1;
@@ -467,7 +707,7 @@ static int setup_plane(struct omap_video_info *video_info)
 	var.xres = src_w;
 	var.yres = src_h;
 	var.xres_virtual = max(src_w, 8);
-	var.yres_virtual = max(src_h, 8) << video_info->double_buffer;
+	var.yres_virtual = max(src_h, 8) * video_info->buffers;
 	var.xoffset = 0;
 	var.yoffset = 0;
 	var.rotate = 0;		/* nb: relative to gfx */
@@ -486,7 +726,8 @@ static int setup_plane(struct omap_video_info *video_info)
 
 	video_info->var = var;
 
-	if (!setup_colorkey(video_info, FALSE))
+	/* Blended planes leave the key to whichever video has it. */
+	if (!video_info->alpha && !setup_colorkey(video_info, FALSE))
 		goto unwind_mem;
 
 	if (ioctl(video_info->fd, OMAPFB_QUERY_PLANE, &plane_info) != 0) {
@@ -511,18 +752,38 @@ static int setup_plane(struct omap_video_info *video_info)
 		ErrorF("omap/video: couldn't get fixed info\n");
 		goto unwind_setup;
 	}
-	video_info->mem =
-	    mmap(NULL, fix.smem_len, PROT_READ | PROT_WRITE, MAP_SHARED,
-		 video_info->fd, 0L);
-	if (video_info->mem == MAP_FAILED) {
-		ErrorF("omap/video: couldn't mmap plane\n");
-		goto unwind_setup;
+	/* Only remap if the memory itself moved or changed size. */
+	if (video_info->map && (video_info->mem_size != fix.smem_len ||
+				video_info->mem_start != fix.smem_start))
+		unmap_plane(video_info);
+	if (!video_info->map) {
+		int offset = fix.smem_start % getpagesize();
+
+		video_info->map =
+		    mmap(NULL, fix.smem_len + offset, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, video_info->fd, 0L);
+		if (video_info->map == MAP_FAILED) {
+			video_info->map = NULL;
+			ErrorF("omap/video: couldn't mmap plane\n");
+			goto unwind_setup;
+		}
+		video_info->mem = video_info->map + offset;
+		video_info->mem_size = fix.smem_len;
+		video_info->mem_start = fix.smem_start;
+		video_info->maps++;
+		DebugF("omap/video: mapped plane %d (%u maps, %u unmaps)\n",
+		       video_info->id, (unsigned int)video_info->maps,
+		       (unsigned int)video_info->unmaps);
 	}
-	video_info->mem += fix.smem_start % getpagesize();
-	video_info->mem_size = fix.smem_len;
 	video_info->dst_pitch = fix.line_length;
 	video_info->dirty = 0;
 
+	video_info->frame_us = omap_output_refresh_us(video_info->fbdev);
+	video_info->front = 0;
+	video_info->back = video_info->buffers > 1;
+	for (i = 0; i < video_info->buffers; i++)
+		video_info->retired[i] = now_us() - video_info->frame_us;
+
 	return 1;
 
 unwind_setup:
@@ -530,21 +791,301 @@ unwind_setup:
 	plane_info.clone_idx = 0;
 	(void)ioctl(video_info->fd, OMAPFB_SETUP_PLANE, &plane_info);
 unwind_mem:
-	(void)alloc_plane_mem(video_info, 0);
+	unmap_plane(video_info);
+	(void)omap_vram_release(vram, video_info->id);
+	omap_video_modify_encoding(video_info->fbdev);
 unwind_start:
 	return 0;
 }
 
+/**
+ * Queue a pan to the buffer just written and move on to the next one.
+ * dispc shadows the offset until the next vblank, so this doesn't wait;
+ * the buffer we leave stays on screen until then.
+ */
+static int pan_plane(struct omap_video_info *video_info, int buffer)
+{
+	struct fb_var_screeninfo var = video_info->var;
+
+	var.yoffset = buffer * var.yres;
+	var.activate = FB_ACTIVATE_VBL;
+
+	return ioctl(video_info->fd, FBIOPAN_DISPLAY, &var) == 0;
+}
+
 static int flip_plane(struct omap_video_info *video_info)
 {
-	if (ioctl(video_info->fd, FBIOPAN_DISPLAY, &video_info->var))
+	if (!pan_plane(video_info, video_info->back))
 		return 0;
 
-	video_info->var.yoffset = video_info->var.yoffset ? 0 : video_info->var.yres;
+	video_info->retired[video_info->front] = now_us();
+	video_info->front = video_info->back;
+	video_info->back = (video_info->back + 1) % video_info->buffers;
 
 	return 1;
 }
 
+/**
+ * Whether the back buffer may still be on screen: it is until the first
+ * vblank after we panned away from it.  With three or more buffers that
+ * only happens when frames come in faster than the refresh rate.
+ */
+static Bool back_busy(struct omap_video_info *video_info)
+{
+	return now_us() - video_info->retired[video_info->back] <
+	    video_info->frame_us;
+}
+
+/**
+ * Push part of the plane to a manual-update panel: w by h pixels at
+ * (x, y) of the plane's input, which the controller scales to wherever
+ * that lands on the output.
+ */
+static void push_rect(struct omap_video_info *video_info, int x, int y,
+		      int w, int h)
+{
+	struct omapfb_update_window update_window;
+	int in_w = video_info->var.xres, in_h = video_info->var.yres;
+
+	update_window.x = x;
+	update_window.y = y;
+	update_window.width = w;
+	update_window.height = h;
+
+	update_window.out_x = x * video_info->dst_w / in_w;
+	update_window.out_y = y * video_info->dst_h / in_h;
+	update_window.out_width = (x + w) * video_info->dst_w / in_w -
+	    update_window.out_x;
+	update_window.out_height = (y + h) * video_info->dst_h / in_h -
+	    update_window.out_y;
+
+	update_window.format = get_omapfb_format(video_info);
+	if (video_info->vsync == OMAP_VSYNC_TEAR)
+		update_window.format |= OMAPFB_FORMAT_FLAG_TEARSYNC;
+	else if (video_info->vsync == OMAP_VSYNC_FORCE)
+		update_window.format |= OMAPFB_FORMAT_FLAG_FORCE_VSYNC;
+
+	/* This fails when the screen's off, so ignore it. */
+	(void)ioctl(video_info->fd, OMAPFB_UPDATE_WINDOW, &update_window);
+}
+
+static void push_frame(struct omap_video_info *video_info)
+{
+	push_rect(video_info, 0, 0, video_info->var.xres,
+		  video_info->var.yres);
+}
+
+/*
+ * Asynchronous presentation.  put_image converts into a free buffer and
+ * posts it; the worker waits for the controller, pans to it and pushes
+ * the update, so none of that waiting happens on the server thread.
+ */
+
+/* A vblank has gone by: whatever was panned away from is off screen. */
+static void retire_all(struct omap_video_info *video_info)
+{
+	CARD32 now = now_us();
+	int i;
+
+	for (i = 0; i < video_info->buffers; i++)
+		if (i != video_info->front &&
+		    now - video_info->retired[i] < video_info->frame_us)
+			video_info->retired[i] = now - video_info->frame_us;
+}
+
+/**
+ * Show one posted buffer.  The previous front buffer only counts as off
+ * screen once a vblank has gone by, which the worker waits for when
+ * vsync is on.
+ */
+static void present_buffer(struct omap_video_info *video_info, int buffer)
+{
+	struct omap_present *p = &video_info->present;
+	int old;
+
+	/* Let the controller finish the last update first. */
+	if (video_info->manual_updates && video_info->vsync != OMAP_VSYNC_NONE)
+		sync_gfx(video_info->fbdev);
+
+	if (!pan_plane(video_info, buffer))
+		return;
+
+	pthread_mutex_lock(&p->lock);
+	old = video_info->front;
+	video_info->front = buffer;
+	video_info->retired[old] = now_us();
+	pthread_mutex_unlock(&p->lock);
+
+	if (video_info->manual_updates)
+		push_frame(video_info);
+	else if (video_info->vsync != OMAP_VSYNC_NONE &&
+		 ioctl(video_info->fd, OMAPFB_WAITFORVSYNC) == 0) {
+		pthread_mutex_lock(&p->lock);
+		retire_all(video_info);
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+static void *present_thread(void *data)
+{
+	struct omap_video_info *video_info = data;
+	struct omap_present *p = &video_info->present;
+	CARD32 latency;
+	int buffer;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;) {
+		while (!p->quit && p->pending < 0)
+			pthread_cond_wait(&p->cond, &p->lock);
+		if (p->quit)
+			break;
+
+		buffer = p->pending;
+		p->pending = -1;
+		p->busy = buffer;
+		latency = now_us() - p->queued;
+		pthread_mutex_unlock(&p->lock);
+
+		present_buffer(video_info, buffer);
+
+		pthread_mutex_lock(&p->lock);
+		p->busy = -1;
+		p->frames++;
+		p->latency_us = latency;
+		pthread_cond_broadcast(&p->cond);
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return NULL;
+}
+
+/**
+ * Start the worker if it isn't running yet.  Signals stay with the
+ * server thread.
+ */
+static Bool present_start(struct omap_video_info *video_info)
+{
+	struct omap_present *p = &video_info->present;
+	sigset_t all, saved;
+	int ret;
+
+	if (p->running)
+		return TRUE;
+
+	pthread_mutex_init(&p->lock, NULL);
+	pthread_cond_init(&p->cond, NULL);
+	p->quit = FALSE;
+	p->pending = -1;
+	p->busy = -1;
+
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &saved);
+	ret = pthread_create(&p->thread, NULL, present_thread, video_info);
+	pthread_sigmask(SIG_SETMASK, &saved, NULL);
+
+	if (ret) {
+		ErrorF("omap/video: couldn't start presentation thread for "
+		       "plane %d, presenting synchronously\n", video_info->id);
+		pthread_cond_destroy(&p->cond);
+		pthread_mutex_destroy(&p->lock);
+		video_info->async = 0;
+		return FALSE;
+	}
+
+	p->running = TRUE;
+
+	return TRUE;
+}
+
+static void present_stop(struct omap_video_info *video_info)
+{
+	struct omap_present *p = &video_info->present;
+
+	if (!p->running)
+		return;
+
+	pthread_mutex_lock(&p->lock);
+	p->quit = TRUE;
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+
+	pthread_join(p->thread, NULL);
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->lock);
+	p->running = FALSE;
+}
+
+/**
+ * Wait until the worker has shown everything posted, before touching
+ * the plane setup under it.
+ */
+static void present_drain(struct omap_video_info *video_info)
+{
+	struct omap_present *p = &video_info->present;
+
+	if (!p->running)
+		return;
+
+	pthread_mutex_lock(&p->lock);
+	while (p->pending >= 0 || p->busy >= 0)
+		pthread_cond_wait(&p->cond, &p->lock);
+	pthread_mutex_unlock(&p->lock);
+}
+
+/**
+ * Pick the buffer for the next frame: neither on screen nor being
+ * flipped to, and one a vblank has certainly passed since it was shown.
+ * Failing that, the frame still in the mailbox is dropped and its buffer
+ * reused.  With the mailbox empty the new frame is dropped instead and
+ * -1 returned: only the worker's own vblank wait retires buffers, the
+ * server thread never waits for one.
+ */
+static int present_back(struct omap_video_info *video_info)
+{
+	struct omap_present *p = &video_info->present;
+	int i, b, best = -1;
+	Bool recent;
+	CARD32 now;
+
+	pthread_mutex_lock(&p->lock);
+	now = now_us();
+	for (i = 1; i < video_info->buffers; i++) {
+		b = (video_info->front + i) % video_info->buffers;
+		if (b == p->pending || b == p->busy)
+			continue;
+		if (best < 0 || now - video_info->retired[b] >
+		    now - video_info->retired[best])
+			best = b;
+	}
+
+	recent = best >= 0 &&
+	    now - video_info->retired[best] < video_info->frame_us;
+
+	if (p->pending >= 0 && (best < 0 || recent)) {
+		best = p->pending;
+		p->pending = -1;
+		p->dropped++;
+	} else if (best < 0 ||
+		   (recent && video_info->vsync != OMAP_VSYNC_NONE)) {
+		best = -1;
+		p->dropped++;
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return best;
+}
+
+static void present_post(struct omap_video_info *video_info, int buffer)
+{
+	struct omap_present *p = &video_info->present;
+
+	pthread_mutex_lock(&p->lock);
+	p->pending = buffer;
+	p->queued = now_us();
+	pthread_cond_broadcast(&p->cond);
+	pthread_mutex_unlock(&p->lock);
+}
+
 /*
  * Enabled the plane
  */
@@ -575,18 +1116,48 @@ static int enable_plane(struct omap_video_info *video_info)
 }
 
 /**
- * Does what it says on the box.
+ * Move or resize the output window of a running plane.  Its memory and
+ * contents stay as they are.
  */
-static void disable_plane(struct omap_video_info *video_info)
+static int move_plane(struct omap_video_info *video_info, int dst_x,
+		      int dst_y, int dst_w, int dst_h)
 {
 	struct omapfb_plane_info plane_info;
 
-	if (video_info->mem)
-		munmap(video_info->mem, video_info->mem_size);
+	present_drain(video_info);
 
-	video_info->mem = NULL;
-	video_info->mem_size = 0;
-	video_info->dst_pitch = 0;
+	if (ioctl(video_info->fd, OMAPFB_QUERY_PLANE, &plane_info) != 0) {
+		ErrorF("omap/video: couldn't get plane info\n");
+		return 0;
+	}
+
+	plane_info.pos_x = dst_x;
+	plane_info.pos_y = dst_y;
+	plane_info.out_width = dst_w;
+	plane_info.out_height = dst_h;
+
+	if (ioctl(video_info->fd, OMAPFB_SETUP_PLANE, &plane_info) != 0) {
+		ErrorF("omap/video: couldn't move plane\n");
+		return 0;
+	}
+
+	video_info->dst_x = dst_x;
+	video_info->dst_y = dst_y;
+	video_info->dst_w = dst_w;
+	video_info->dst_h = dst_h;
+
+	return 1;
+}
+
+/**
+ * Does what it says on the box.
+ */
+static void disable_plane(struct omap_video_info *video_info, Bool keep_mem)
+{
+	struct omapfb_plane_info plane_info;
+
+	if (!keep_mem)
+		unmap_plane(video_info);
 
 	if (ioctl(video_info->fd, OMAPFB_QUERY_PLANE, &plane_info) != 0) {
 		ErrorF("omap/video: couldn't get plane info\n");
@@ -601,10 +1172,14 @@ static void disable_plane(struct omap_video_info *video_info)
 		return;
 	}
 
-	if (!alloc_plane_mem(video_info, 0)) {
-		ErrorF("omap/video: couldn't deallocate plane\n");
+	if (keep_mem)
 		return;
-	}
+
+	if (!omap_vram_release(video_info->fbdev->vram, video_info->id))
+		ErrorF("omap/video: couldn't deallocate plane\n");
+
+	/* Let the encoding follow what's free now. */
+	omap_video_modify_encoding(video_info->fbdev);
 }
 
 static void drawable_destroyed(FBDevPtr fbdev, DrawablePtr drawable)
@@ -617,6 +1192,9 @@ static void drawable_destroyed(FBDevPtr fbdev, DrawablePtr drawable)
 		if (video_info->drawable == drawable)
 			video_info->drawable = NULL;
 	}
+
+	omap_hold_drawable_destroyed(fbdev, drawable);
+	omap_scanout_drawable_destroyed(drawable);
 }
 
 static Bool destroy_pixmap_hook(PixmapPtr pixmap)
@@ -682,6 +1260,17 @@ static void change_overlay_property(struct omap_video_info *video_info, int val)
 	video_info->overlay_active = val;
 }
 
+/* Paint region with key, on the SGX where we can. */
+static void paint_ckey(DrawablePtr drawable, Pixel key, RegionPtr region)
+{
+	if (!REGION_NOTEMPTY(drawable->pScreen, region))
+		return;
+
+	if (!PVR2DFillRegion(drawable, key, region))
+		xf86XVFillKeyHelperDrawable(drawable, key, region);
+	DamageDamageRegion(drawable, region);
+}
+
 static void empty_clip(struct omap_video_info *video_info)
 {
 	change_overlay_property(video_info, 0);
@@ -691,8 +1280,8 @@ static void empty_clip(struct omap_video_info *video_info)
 			RegionRec clip;
 			REGION_INIT(video_info->fbdev->screen, &clip, NullBox, 0);
 			REGION_COPY(video_info->fbdev->screen, &clip, &video_info->clip);
-			xf86XVFillKeyHelperDrawable(video_info->drawable, video_info->fbdev->screen->blackPixel, &clip);
-			DamageDamageRegion(video_info->drawable, &clip);
+			paint_ckey(video_info->drawable, video_info->fbdev->screen->blackPixel, &clip);
+			REGION_UNINIT(video_info->fbdev->screen, &clip);
 		}
 		video_info->drawable = NULL;
 		REGION_EMPTY(video_info->fbdev->screen, &video_info->clip);
@@ -700,10 +1289,13 @@ static void empty_clip(struct omap_video_info *video_info)
 }
 
 /**
- * Stop the video overlay.
+ * Stop the video overlay.  keep_mem leaves the plane memory allocated and
+ * mapped, for a restart that will use it again.
  */
-static void stop_video(struct omap_video_info *video_info)
+static void stop_video(struct omap_video_info *video_info, Bool keep_mem)
 {
+	present_drain(video_info);
+
 	/* Stop TV-out if it's cloning this plane. */
 	if (omap_tvout_src_plane(video_info->fbdev) == video_info->id + 1)
 		omap_tvout_stop(video_info->fbdev);
@@ -714,7 +1306,7 @@ static void stop_video(struct omap_video_info *video_info)
 		empty_clip(video_info);
 
 	if (video_info->state == OMAP_STATE_ACTIVE)
-		disable_plane(video_info);
+		disable_plane(video_info, keep_mem);
 
 	video_info->state = OMAP_STATE_STOPPED;
 
@@ -723,41 +1315,18 @@ static void stop_video(struct omap_video_info *video_info)
 	DebugF("omap stop_video: stopped plane %d\n", video_info->id);
 }
 
-static void push_frame(struct omap_video_info *video_info)
+/**
+ * When the clip on a window changes, check it and stash it away, so we
+ * don't end up with any clipped windows on the external controller.
+ */
+static void omap_video_clip_notify(ScrnInfoPtr screen, void *data,
+				   WindowPtr window, int dx, int dy)
 {
-	struct omapfb_update_window update_window;
+	struct omap_video_info *video_info = data;
 
-	update_window.x = 0;
-	update_window.y = 0;
-	update_window.out_x = 0;
-	update_window.out_y = 0;
-	update_window.out_width = video_info->dst_w;
-	update_window.out_width = video_info->dst_h;
-
-	update_window.format = get_omapfb_format(video_info);
-	update_window.width = video_info->dst_w;
-	update_window.width = video_info->dst_h;
-
-	if (video_info->vsync == OMAP_VSYNC_TEAR)
-		update_window.format |= OMAPFB_FORMAT_FLAG_TEARSYNC;
-	else if (video_info->vsync == OMAP_VSYNC_FORCE)
-		update_window.format |= OMAPFB_FORMAT_FLAG_FORCE_VSYNC;
-
-	/* This fails when the screen's off, so ignore it. */
-	(void)ioctl(video_info->fd, OMAPFB_UPDATE_WINDOW, &update_window);
-}
-
-/**
- * When the clip on a window changes, check it and stash it away, so we
- * don't end up with any clipped windows on the external controller.
- */
-static void omap_video_clip_notify(ScrnInfoPtr screen, void *data,
-				   WindowPtr window, int dx, int dy)
-{
-	struct omap_video_info *video_info = data;
-
-	video_info->visibility = window->visibility;
-}
+	video_info->visibility = window->visibility;
+	omap_hold_kick(&video_info->hold);
+}
 
 /**
  * Xv attributes get/set support.
@@ -774,7 +1343,11 @@ static int omap_video_get_attribute(ScrnInfoPtr screen, Atom attribute,
 		LEAVE();
 		return Success;
 	} else if (attribute == xv_double_buffer) {
-		*value = video_info->double_buffer;
+		*value = video_info->num_buffers > 1;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_buffers) {
+		*value = video_info->num_buffers;
 		LEAVE();
 		return Success;
 	} else if (attribute == xv_ckey) {
@@ -809,6 +1382,38 @@ static int omap_video_get_attribute(ScrnInfoPtr screen, Atom attribute,
 		*value = video_info->overlay_active;
 		LEAVE();
 		return Success;
+	} else if (attribute == xv_omap_scale_filter) {
+		*value = video_info->scale_filter;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_native_yuv420) {
+		*value = video_info->native_yuv420;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_async) {
+		*value = video_info->async;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_frames) {
+		*value = video_info->present.frames & 0x7fffffff;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_dropped_frames) {
+		*value = video_info->present.dropped & 0x7fffffff;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_queue_latency) {
+		*value = video_info->present.latency_us & 0x7fffffff;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_maps) {
+		*value = video_info->maps & 0x7fffffff;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_unmaps) {
+		*value = video_info->unmaps & 0x7fffffff;
+		LEAVE();
+		return Success;
 	}
 
 	LEAVE();
@@ -845,7 +1450,17 @@ static int omap_video_set_attribute(ScrnInfoPtr screen, Atom attribute,
 			return BadValue;
 		}
 
-		video_info->double_buffer = value;
+		video_info->num_buffers = value + 1;
+		video_info->dirty = TRUE;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_buffers) {
+		if (value < 1 || value > OMAP_MAX_FLIP_BUFFERS) {
+			LEAVE();
+			return BadValue;
+		}
+
+		video_info->num_buffers = value;
 		video_info->dirty = TRUE;
 		LEAVE();
 		return Success;
@@ -902,6 +1517,44 @@ static int omap_video_set_attribute(ScrnInfoPtr screen, Atom attribute,
 		int ret = omap_tvout_set_tv_scale(video_info->fbdev, value);
 		LEAVE();
 		return ret;
+	} else if (attribute == xv_omap_scale_filter) {
+		if (value < OMAP_SCALE_NEAREST || value > OMAP_SCALE_BOX) {
+			LEAVE();
+			return BadValue;
+		}
+
+		video_info->scale_filter = value;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_native_yuv420) {
+		if (value != 0 && value != 1) {
+			LEAVE();
+			return BadValue;
+		}
+
+		if (!video_info->yuv420_caps && value) {
+			ErrorF
+			    ("omap_video_set_attribute: requested YUV420 on a "
+			     "plane without YUV420 support\n");
+			LEAVE();
+			return BadValue;
+		}
+
+		video_info->native_yuv420 = value;
+		video_info->dirty = TRUE;
+		LEAVE();
+		return Success;
+	} else if (attribute == xv_omap_async) {
+		if (value != 0 && value != 1) {
+			LEAVE();
+			return BadValue;
+		}
+
+		if (!value)
+			present_drain(video_info);
+		video_info->async = value;
+		LEAVE();
+		return Success;
 	}
 
 	LEAVE();
@@ -946,6 +1599,8 @@ static void omap_video_query_best_size(ScrnInfoPtr screen, Bool motion,
  */
 static int start_video(struct omap_video_info *video_info)
 {
+	int ok;
+
 	/* Stop TV-out if it's using this plane. */
 	if (omap_tvout_clone_plane(video_info->fbdev) == video_info->id + 1)
 		omap_tvout_stop(video_info->fbdev);
@@ -953,10 +1608,22 @@ static int start_video(struct omap_video_info *video_info)
 	if (video_info->state == OMAP_STATE_ACTIVE) {
 		DebugF("omap/start_video: plane %d still active!\n",
 		       video_info->id);
-		stop_video(video_info);
+		stop_video(video_info, TRUE);
 	}
 
-	if (!setup_plane(video_info)) {
+	ok = setup_plane(video_info);
+	if (!ok && video_info->yuv420) {
+		/* Not every controller takes YUV420 after all; stop asking
+		 * and expand to YUY2 instead. */
+		DebugF("omap/start_video: plane %d refused YUV420\n",
+		       video_info->id);
+		video_info->yuv420 = 0;
+		video_info->yuv420_caps = 0;
+		video_info->native_yuv420 = 0;
+		ok = setup_plane(video_info);
+	}
+
+	if (!ok) {
 		DebugF("omap/start_video: couldn't enable plane %d\n",
 		       video_info->id);
 
@@ -982,9 +1649,18 @@ void omap_video_stop(ScrnInfoPtr screen, pointer data, Bool exit)
 	FBDevPtr fbdev = screen->driverPrivate;
 	struct omap_video_info *video_info = data;
 
+	/* Only the auto adaptor may stop a plane it has borrowed, and it
+	 * returns the plane first. */
+	if (video_info->borrower || video_info->lent)
+		return;
+
 	ENTER();
 
-	stop_video(video_info);
+	omap_hold_drop(&video_info->hold);
+
+	/* A paused port keeps its memory and mapping for when it resumes;
+	 * only a port that is done with gives them back. */
+	stop_video(video_info, !exit);
 
 	video_info->dirty = TRUE;
 
@@ -1001,6 +1677,9 @@ void omap_video_stop(ScrnInfoPtr screen, pointer data, Bool exit)
 		video_info->ckey = default_ckey(screen);
 		video_info->autopaint_ckey = 1;
 		video_info->disable_ckey = 0;
+		video_info->scale_filter = OMAP_SCALE_BILINEAR;
+		video_info->native_yuv420 = video_info->yuv420_caps;
+		video_info->async = 1;
 	}
 
 	video_info->drawable = NULL;
@@ -1020,27 +1699,19 @@ static Bool setup_overlay(ScrnInfoPtr screen,
 			  DrawablePtr drawable)
 {
 	WindowPtr window;
-	int maxvdownscale;
 
 	ENTER();
 
+	/* Keep the memory and mapping; setup_plane only reallocates when
+	 * the new frame needs more. */
 	if (video_info->state == OMAP_STATE_ACTIVE) {
 		DebugF("omap/setup_overlay: restarting overlay %d\n",
 		       video_info->id);
-		stop_video(video_info);
+		stop_video(video_info, TRUE);
 	}
 
-	maxvdownscale = src_w > 1024 ? 2 : 4;
-
-	if (src_w > dst_w * 4 || src_w * 8 < dst_w)
-		video_info->hscale = TRUE;
-	else
-		video_info->hscale = FALSE;
-
-	if (src_h > dst_h * maxvdownscale || src_h * 8 < dst_h)
-		video_info->vscale = TRUE;
-	else
-		video_info->vscale = FALSE;
+	calc_scaling(src_w, src_h, dst_w, dst_h, &video_info->hscale,
+		     &video_info->vscale);
 
 	video_info->src_w = src_w;
 	video_info->src_h = src_h;
@@ -1051,6 +1722,13 @@ static Bool setup_overlay(ScrnInfoPtr screen,
 	video_info->fourcc = id;
 	video_info->drawable = drawable;
 
+	/* YUV420 takes 12 bits per pixel rather than 16, but comes in 4x2
+	 * blocks, with no scaling or rotation in the conversion. */
+	video_info->yuv420 = video_info->native_yuv420
+	    && (id == FOURCC_YV12 || id == FOURCC_I420)
+	    && !video_info->hscale && !video_info->vscale
+	    && video_info->rotation == RR_Rotate_0 && src_w >= 4;
+
 	switch (id) {
 	case FOURCC_YV12:
 	case FOURCC_I420:
@@ -1081,23 +1759,30 @@ static Bool setup_overlay(ScrnInfoPtr screen,
 }
 
 /**
- * XvPutImage hook.  This does not deal with rotation or partial updates.
+ * Put an image on the plane.  When the screen is rotated the plane is set
+ * up in panel orientation and the image is rotated while it is copied.
+ * Puts covering part of the current frame only convert that part.
  *
  * Calls out to omapCopyPlanarData (unobscured planar video),
  * omapExpandPlanarData (downscaled planar),
  * omapCopyPackedData (downscaled packed), xf86XVCopyPlanarData (obscured planar),
  * or xf86XVCopyPackedData (packed).
  */
-static int omap_video_put(ScrnInfoPtr screen, short src_x, short src_y,
-			  short dst_x, short dst_y, short src_w, short src_h,
-			  short dst_w, short dst_h, int id, unsigned char *buf,
-			  short width, short height, Bool sync,
-			  RegionPtr clip_boxes, pointer data,
-			  DrawablePtr drawable)
+static int put_image(ScrnInfoPtr screen, short src_x, short src_y,
+		     short dst_x, short dst_y, short src_w, short src_h,
+		     short dst_w, short dst_h, int id, unsigned char *buf,
+		     short width, short height, Bool sync,
+		     RegionPtr clip_boxes, pointer data, DrawablePtr drawable)
 {
 	struct omap_video_info *video_info = (struct omap_video_info *)data;
-	int need_ckey = 0;
+	xf86CrtcPtr crtc = video_info->fbdev->crtc_lcd;
+	Rotation rotation = RR_Rotate_0;
+	short plane_w, plane_h;
+	int need_ckey = video_info->drawable != drawable;
 	int enable = 0;
+	Bool partial = FALSE;
+	Bool async;
+	int back;
 	CARD8 *mem;
 
 	/* Failure here means simply that there is nothing to draw */
@@ -1106,17 +1791,70 @@ static int omap_video_put(ScrnInfoPtr screen, short src_x, short src_y,
 		return Success;
 	}
 
-	if (is_dirty(video_info, id, src_w, src_h, dst_x, dst_y, dst_w, dst_h)
-	    || !video_info->mem) {
-		if (!setup_overlay(screen, video_info, id, src_w, src_h, dst_x, dst_y, dst_w, dst_h, drawable)) {
-			ErrorF
-			    ("omap/put_image: failed to set up overlay: from (%d, %d) "
-			     "to (%d, %d) at (%d, %d) on plane %d\n", src_w, src_h, dst_w, dst_h, dst_x, dst_y, video_info->id);
-			return BadAlloc;
+	/* From here on dst is in panel coordinates, and the plane is fed
+	 * the rotated image. */
+	if (crtc)
+		rotation = crtc->rotation & (RR_Rotate_0 | RR_Rotate_90 |
+					     RR_Rotate_180 | RR_Rotate_270);
+	rotate_box(video_info->fbdev, rotation, &dst_x, &dst_y, &dst_w,
+		   &dst_h);
+	if (rotation & (RR_Rotate_90 | RR_Rotate_270)) {
+		plane_w = src_h;
+		plane_h = src_w;
+	} else {
+		plane_w = src_w;
+		plane_h = src_h;
+	}
+
+	if (is_partial(video_info, id, rotation, drawable, src_x, src_y, src_w,
+		       src_h, dst_x, dst_y, dst_w, dst_h)) {
+		partial = TRUE;
+
+		/* Keep YUV macropixels whole, and inside the plane. */
+		if (id != FOURCC_RV16 && id != FOURCC_RV32) {
+			int end = video_info->src_x + (video_info->src_w & ~1);
+
+			if ((src_x - video_info->src_x) & 1) {
+				src_x--;
+				src_w++;
+			}
+			if (src_w & 1)
+				src_w++;
+			if (src_x + src_w > end)
+				src_w = end - src_x;
+			if (src_w <= 0)
+				return Success;
 		}
+	} else {
+		switch (plane_change(video_info, id, plane_w, plane_h, dst_x,
+				     dst_y, dst_w, dst_h, rotation)) {
+		case PLANE_UNCHANGED:
+			break;
+		case PLANE_MOVED:
+		case PLANE_RESIZED:
+			if (move_plane(video_info, dst_x, dst_y, dst_w, dst_h)) {
+				video_info->drawable = drawable;
+				break;
+			}
+			/* fall through */
+		case PLANE_CHANGED:
+			video_info->rotation = rotation;
+			if (!setup_overlay(screen, video_info, id, plane_w, plane_h, dst_x, dst_y, dst_w, dst_h, drawable)) {
+				ErrorF
+				    ("omap/put_image: failed to set up overlay: from (%d, %d) "
+				     "to (%d, %d) at (%d, %d) on plane %d\n", plane_w, plane_h, dst_w, dst_h, dst_x, dst_y, video_info->id);
+				return BadAlloc;
+			}
 
-		need_ckey = 1;
-		enable = 1;
+			need_ckey = 1;
+			enable = 1;
+			break;
+		}
+	}
+
+	if (!partial) {
+		video_info->src_x = src_x;
+		video_info->src_y = src_y;
 	}
 
 	if (enable)
@@ -1124,54 +1862,78 @@ static int omap_video_put(ScrnInfoPtr screen, short src_x, short src_y,
 		       "(%d, %d, %d, %d)\n", src_x, src_y, src_w,
 		       src_h, dst_x, dst_y, dst_w, dst_h);
 
+	/* A freshly set up plane gets its first frame synchronously, so it
+	 * is in place when the plane is enabled. */
+	async = video_info->async && video_info->buffers > 1 && !enable
+	    && present_start(video_info);
+
 	/* Sync the engine first, so we don't draw over something that's still
-	 * being scanned out. */
-	if (video_info->vsync != OMAP_VSYNC_NONE)
-		sync_gfx(video_info->fbdev);
+	 * being scanned out.  When flipping, the back buffer is normally
+	 * off screen already, and only waits for a vblank if it isn't; the
+	 * worker never makes us wait, it drops the frame instead. */
+	if (async) {
+		back = present_back(video_info);
+		if (back < 0)
+			goto dropped;
+		video_info->back = back;
+	} else if (video_info->vsync != OMAP_VSYNC_NONE) {
+		if (video_info->buffers == 1)
+			sync_gfx(video_info->fbdev);
+		else if (back_busy(video_info))
+			ioctl(video_info->fd, OMAPFB_WAITFORVSYNC);
+	}
 
-	mem = video_info->mem + video_info->var.yoffset * video_info->dst_pitch;
+	mem = video_info->mem +
+	    video_info->back * video_info->var.yres * video_info->dst_pitch;
+	if (partial)
+		mem += (src_y - video_info->src_y) * video_info->dst_pitch +
+		    (src_x - video_info->src_x) * (id == FOURCC_RV32 ? 4 : 2);
 
 	switch (id) {
 	case FOURCC_RV32:
 		if (video_info->hscale || video_info->vscale)
-			omap_copy_scale_32(video_info->hscale, video_info->vscale, buf, mem, RR_Rotate_0,
+			omap_copy_scale_32(video_info->hscale, video_info->vscale, buf, mem, video_info->rotation,
 					   OMAP_RV32_PITCH(width), video_info->dst_pitch, src_w, src_h, src_x, src_y, width,
 					   height, dst_w, dst_h);
 		else
-			omap_copy_32(buf, mem, RR_Rotate_0, OMAP_RV32_PITCH(width), video_info->dst_pitch, src_w,
+			omap_copy_32(buf, mem, video_info->rotation, OMAP_RV32_PITCH(width), video_info->dst_pitch, src_w,
 				     src_h, src_x, src_y, width, height);
 		break;
 
 	case FOURCC_RV16:
 		if (video_info->hscale || video_info->vscale)
-			omap_copy_scale_16(video_info->hscale, video_info->vscale, buf, mem, RR_Rotate_0,
+			omap_copy_scale_16(video_info->hscale, video_info->vscale, buf, mem, video_info->rotation,
 					   OMAP_RV16_PITCH(width), video_info->dst_pitch, src_w, src_h, src_x, src_y, width,
 					   height, dst_w, dst_h);
 		else
-			omap_copy_16(buf, mem, RR_Rotate_0, OMAP_RV16_PITCH(width), video_info->dst_pitch, src_w,
+			omap_copy_16(buf, mem, video_info->rotation, OMAP_RV16_PITCH(width), video_info->dst_pitch, src_w,
 				     src_h, src_x, src_y, width, height);
 		break;
 
 	case FOURCC_UYVY:
 	case FOURCC_YUY2:
 		if (video_info->hscale || video_info->vscale)
-			omap_copy_scale_packed(video_info->hscale, video_info->vscale, buf, mem, RR_Rotate_0,
-					       OMAP_YUY2_PITCH(width), video_info->dst_pitch, src_w, src_h, src_x, src_y, width,
-					       height, dst_w, dst_h);
+			omap_copy_filter_packed(video_info->scale_filter, video_info->hscale, video_info->vscale, buf,
+						mem, video_info->rotation, OMAP_YUY2_PITCH(width), video_info->dst_pitch, src_w, src_h,
+						src_x, src_y, width, height, id, dst_w, dst_h);
 		else
-			omap_copy_packed(buf, mem, RR_Rotate_0, OMAP_YUY2_PITCH(width), video_info->dst_pitch,
-					 src_w, src_h, src_x, src_y, width, height);
+			omap_copy_packed(buf, mem, video_info->rotation, OMAP_YUY2_PITCH(width), video_info->dst_pitch,
+					 src_w, src_h, src_x, src_y, width, height, id);
 		break;
 
 	case FOURCC_YV12:
 	case FOURCC_I420:
-		if (video_info->hscale || video_info->vscale)
-			omap_copy_scale_planar(video_info->hscale, video_info->vscale, buf, mem, RR_Rotate_0,
-					       OMAP_YV12_PITCH_LUMA(width), OMAP_YV12_PITCH_CHROMA(width),
-					       video_info->dst_pitch, src_w, src_h, src_x, src_y, width, height, id, dst_w,
-					       dst_h);
+		if (video_info->yuv420)
+			omap_copy_yuv420(buf, mem, video_info->rotation, OMAP_YV12_PITCH_LUMA(width),
+					 OMAP_YV12_PITCH_CHROMA(width), video_info->dst_pitch, src_w, src_h, src_x,
+					 src_y, width, height, id);
+		else if (video_info->hscale || video_info->vscale)
+			omap_copy_filter_planar(video_info->scale_filter, video_info->hscale, video_info->vscale, buf,
+						mem, video_info->rotation, OMAP_YV12_PITCH_LUMA(width),
+						OMAP_YV12_PITCH_CHROMA(width), video_info->dst_pitch, src_w, src_h, src_x,
+						src_y, width, height, id, dst_w, dst_h);
 		else
-			omap_copy_planar(buf, mem, RR_Rotate_0, OMAP_YV12_PITCH_LUMA(width),
+			omap_copy_planar(buf, mem, video_info->rotation, OMAP_YV12_PITCH_LUMA(width),
 					 OMAP_YV12_PITCH_CHROMA(width), video_info->dst_pitch, src_w, src_h, src_x, src_y,
 					 width, height, id);
 		break;
@@ -1181,28 +1943,84 @@ static int omap_video_put(ScrnInfoPtr screen, short src_x, short src_y,
 	if (video_info->disable_ckey)
 		set_ckey_timer(video_info);
 
-	if (video_info->double_buffer)
-		flip_plane(video_info);
-
-	if (enable)
-		enable_plane(video_info);
+	if (async) {
+		present_post(video_info, video_info->back);
+	} else {
+		if (video_info->buffers > 1)
+			flip_plane(video_info);
+
+		if (enable)
+			enable_plane(video_info);
+
+		/* Partial puts only push what they redrew. */
+		if (video_info->manual_updates && partial)
+			push_rect(video_info, src_x - video_info->src_x,
+				  src_y - video_info->src_y, src_w, src_h);
+		else if (video_info->manual_updates)
+			push_frame(video_info);
+	}
 
-	if (video_info->manual_updates)
-		push_frame(video_info);
+ dropped:
+	/* A partial put's clip only covers the part it redrew. */
+	if (!partial
+	    && !REGION_EQUAL(screen->pScreen, &video_info->clip, clip_boxes)) {
+		/* The key moves along with the window contents, so only
+		 * what has come into the clip since needs painting. */
+		if (!need_ckey && video_info->autopaint_ckey) {
+			RegionRec exposed;
+
+			REGION_TRANSLATE(screen->pScreen, &video_info->clip,
+					 drawable->x - video_info->clip_x,
+					 drawable->y - video_info->clip_y);
+			REGION_NULL(screen->pScreen, &exposed);
+			REGION_SUBTRACT(screen->pScreen, &exposed, clip_boxes,
+					&video_info->clip);
+			paint_ckey(drawable, video_info->ckey, &exposed);
+			REGION_UNINIT(screen->pScreen, &exposed);
+		}
 
-	if (!REGION_EQUAL(screen->pScreen, &video_info->clip, clip_boxes)) {
 		REGION_COPY(screen->pScreen, &video_info->clip, clip_boxes);
-		need_ckey = 1;
+		video_info->clip_x = drawable->x;
+		video_info->clip_y = drawable->y;
 	}
 
-	if (need_ckey && video_info->autopaint_ckey) {
-		xf86XVFillKeyHelperDrawable(drawable, video_info->ckey, clip_boxes);
-		DamageDamageRegion(drawable, clip_boxes);
-	}
+	if (need_ckey && video_info->autopaint_ckey)
+		paint_ckey(drawable, video_info->ckey, clip_boxes);
 
 	return Success;
 }
 
+static int omap_video_put(ScrnInfoPtr screen, short src_x, short src_y,
+			  short dst_x, short dst_y, short src_w, short src_h,
+			  short dst_w, short dst_h, int id, unsigned char *buf,
+			  short width, short height, Bool sync,
+			  RegionPtr clip_boxes, pointer data,
+			  DrawablePtr drawable)
+{
+	struct omap_video_info *video_info = (struct omap_video_info *)data;
+
+	/* Video asked for this plane by name, so it wins over whoever
+	 * borrowed it outside of Xv. */
+	if (video_info->lent && video_info->reclaim)
+		video_info->reclaim(video_info->reclaim_data);
+
+	/* The plane is in use by the auto adaptor, or still lent out. */
+	if (video_info->borrower || video_info->lent)
+		return BadAlloc;
+
+	if (!omap_output_visible(video_info->fbdev, drawable)) {
+		omap_hold_frame(&video_info->hold, src_x, src_y, dst_x, dst_y,
+				src_w, src_h, dst_w, dst_h, id, buf, width,
+				height, drawable);
+		return Success;
+	}
+	omap_hold_drop(&video_info->hold);
+
+	return put_image(screen, src_x, src_y, dst_x, dst_y, src_w, src_h,
+			 dst_w, dst_h, id, buf, width, height, sync,
+			 clip_boxes, data, drawable);
+}
+
 /**
  * Give image size and pitches.
  */
@@ -1337,55 +2155,6 @@ static int omap_video_count_planes(FBDevPtr fbdev)
 	return j;
 }
 
-static void omap_video_modify_encoding(FBDevPtr fbdev)
-{
-	unsigned int vram, max_w, max_h;
-	struct omapfb_vram_info vram_info;
-
-	ENTER();
-
-	/* Calculate the max image size (of a certain aspect ratio) which will
-	 * fit into the available memory. */
-	if (!(ioctl(fbdev->fd, OMAPFB_GET_VRAM_INFO, &vram_info)))
-		vram = vram_info.largest_free_block;
-	else if (!(vram = omap_vram_get_avail()))
-		ErrorF("omap/video: couldn't get vram info\n");
-
-	vram /= MAX_PLANES;
-	vram -= vram % getpagesize();
-	vram /= MAX_BYTES_PER_PIXEL * MAX_BUFFERS;
-
-	/* Try 16:9 first. */
-	max_h = sqrt(9 * vram / 16);
-	max_w = 16 * max_h / 9;
-
-	/* Only use 16:9 if 720p is possible, otherwise fall back to 4:3. */
-	if (max_w < 1280 || max_h < 720) {
-		max_h = sqrt(3 * vram / 4);
-		max_w = 4 * max_h / 3;
-	}
-
-	/* Hardware limits */
-	if (max_w > VIDEO_IMAGE_MAX_WIDTH) {
-		max_h =
-		    min(VIDEO_IMAGE_MAX_WIDTH, vram / VIDEO_IMAGE_MAX_WIDTH);
-		max_w = VIDEO_IMAGE_MAX_WIDTH;
-	}
-	if (max_h > VIDEO_IMAGE_MAX_HEIGHT) {
-		max_h = VIDEO_IMAGE_MAX_HEIGHT;
-		max_w =
-		    min(VIDEO_IMAGE_MAX_HEIGHT, vram / VIDEO_IMAGE_MAX_HEIGHT);
-	}
-
-	/* Only full macropixels */
-	max_w &= ~1;
-
-	DummyEncoding.width = max_w;
-	DummyEncoding.height = max_h;
-
-	LEAVE();
-}
-
 static Bool omap_video_setup_private(ScreenPtr screen,
 				     struct omap_video_info *video_info, int i)
 {
@@ -1406,7 +2175,7 @@ static Bool omap_video_setup_private(ScreenPtr screen,
 	 * we take control.
 	 * FIXME: I think this only applies to the GFX plane? -- Oliver.
 	 */
-	if (!alloc_plane_mem(video_info, 0)) {
+	if (!omap_vram_add_plane(fbdev->vram, i - 1, video_info->fd)) {
 		ErrorF("omap/video: couldn't allocate plane mem\n");
 		LEAVE();
 		return FALSE;
@@ -1415,6 +2184,8 @@ static Bool omap_video_setup_private(ScreenPtr screen,
 	video_info->caps = plane_caps.ctrl;
 	video_info->manual_updates =
 	    !!(video_info->caps & OMAPFB_CAPS_MANUAL_UPDATE);
+	video_info->yuv420_caps =
+	    !!(plane_caps.plane_color & (1 << OMAPFB_COLOR_YUV420));
 
 	video_info->id = i - 1;
 	video_info->state = OMAP_STATE_STOPPED;
@@ -1424,6 +2195,11 @@ static Bool omap_video_setup_private(ScreenPtr screen,
 	video_info->visibility = VisibilityPartiallyObscured;
 	video_info->autopaint_ckey = 1;
 	video_info->disable_ckey = 0;
+	video_info->scale_filter = OMAP_SCALE_BILINEAR;
+	video_info->native_yuv420 = video_info->yuv420_caps;
+	video_info->num_buffers = 1;
+	video_info->buffers = 1;
+	video_info->async = 1;
 	video_info->ckey = default_ckey(xf86screen);
 	if (video_info->caps & OMAPFB_CAPS_TEARSYNC)
 		video_info->vsync = OMAP_VSYNC_TEAR;
@@ -1443,11 +2219,16 @@ static void omap_video_free_adaptor(FBDevPtr fbdev, XF86VideoAdaptorPtr adapt)
 	if (adapt->pPortPrivates)
 		for (i = 1; i <= fbdev->num_video_ports; ++i) {
 			video_info = adapt->pPortPrivates[i - 1].ptr;
+			present_stop(video_info);
+			unmap_plane(video_info);
 			close(video_info->fd);
 			xfree(video_info);
 		}
 	xfree(adapt->pPortPrivates);
 	xfree(adapt);
+
+	omap_vram_fini(fbdev->vram);
+	fbdev->vram = NULL;
 }
 
 /**
@@ -1466,12 +2247,13 @@ static XF86VideoAdaptorPtr omap_video_setup_adaptor(ScreenPtr screen)
 	if (!num_video_ports)
 		return NULL;
 
-	/* Modify the encoding to contain our real min/max values. */
-	omap_video_modify_encoding(fbdev);
-
 	if (!(adapt = xcalloc(1, sizeof(XF86VideoAdaptorRec))))
 		return NULL;
 
+	fbdev->vram = omap_vram_init(fbdev->fd);
+	if (!fbdev->vram)
+		goto unwind;
+
 	adapt->type = XvWindowMask | XvInputMask | XvImageMask;
 	adapt->flags = VIDEO_CLIP_TO_VIEWPORT | VIDEO_OVERLAID_IMAGES;
 	adapt->name = "OMAP Video Overlay";
@@ -1516,18 +2298,37 @@ static XF86VideoAdaptorPtr omap_video_setup_adaptor(ScreenPtr screen)
 		adapt->nPorts++;
 	}
 
+	/* Modify the encoding to contain our real min/max values, now that
+	 * the planes have given up their memory. */
+	omap_video_modify_encoding(fbdev);
+
 	xv_ckey = MAKE_ATOM("XV_COLORKEY");
 	xv_autopaint_ckey = MAKE_ATOM("XV_AUTOPAINT_COLORKEY");
 	xv_disable_ckey = MAKE_ATOM("XV_DISABLE_COLORKEY");
 	xv_double_buffer = MAKE_ATOM("XV_DOUBLE_BUFFER");
+	xv_omap_buffers = MAKE_ATOM("XV_OMAP_BUFFERS");
 	xv_vsync = MAKE_ATOM("XV_OMAP_VSYNC");
 	xv_omap_clone_to_tvout = MAKE_ATOM("XV_OMAP_CLONE_TO_TVOUT");
 	xv_omap_tvout_standard = MAKE_ATOM("XV_OMAP_TVOUT_STANDARD");
 	xv_omap_tvout_widescreen = MAKE_ATOM("XV_OMAP_TVOUT_WIDESCREEN");
 	xv_omap_tvout_scale = MAKE_ATOM("XV_OMAP_TVOUT_SCALE");
 	xv_omap_overlay_active = MAKE_ATOM("XV_OMAP_OVERLAY_ACTIVE");
+	xv_omap_scale_filter = MAKE_ATOM("XV_OMAP_SCALE_FILTER");
+	xv_omap_native_yuv420 = MAKE_ATOM("XV_OMAP_NATIVE_YUV420");
+	xv_omap_async = MAKE_ATOM("XV_OMAP_ASYNC");
+	xv_omap_frames = MAKE_ATOM("XV_OMAP_FRAMES");
+	xv_omap_dropped_frames = MAKE_ATOM("XV_OMAP_DROPPED_FRAMES");
+	xv_omap_queue_latency = MAKE_ATOM("XV_OMAP_QUEUE_LATENCY");
+	xv_omap_maps = MAKE_ATOM("XV_OMAP_MAPS");
+	xv_omap_unmaps = MAKE_ATOM("XV_OMAP_UNMAPS");
 	_omap_video_overlay = MAKE_ATOM("_OMAP_VIDEO_OVERLAY");
 
+	for (i = 0; i < num_video_ports; i++) {
+		video_info = adapt->pPortPrivates[i].ptr;
+		omap_hold_init(&video_info->hold, fbdev, omap_video_put,
+			       omap_video_query_attributes, video_info);
+	}
+
 	fbdev->num_video_ports = num_video_ports;
 	fbdev->overlay_adaptor = adapt;
 
@@ -1542,6 +2343,477 @@ unwind:
 	return NULL;
 }
 
+/*
+ * The auto adaptor: each port routes every frame to the cheapest backend
+ * that can show it.  That is an overlay plane when the window is
+ * unobscured and the scaling within the plane's
+ * limits, and SGX textured video otherwise.  Planes are borrowed from the
+ * overlay adaptor while they are idle.
+ */
+enum omap_auto_backend {
+	OMAP_AUTO_NONE,
+	OMAP_AUTO_OVERLAY,
+	OMAP_AUTO_TEXTURED,
+};
+
+/* Why a frame went where it went. */
+enum omap_auto_route {
+	OMAP_ROUTE_OVERLAY,
+	OMAP_ROUTE_RGB,
+	OMAP_ROUTE_FORMAT,
+	OMAP_ROUTE_OBSCURED,
+	OMAP_ROUTE_SCALING,
+	OMAP_ROUTE_NO_PLANE,
+	OMAP_ROUTE_COUNT,
+};
+
+static const char *omap_route_names[OMAP_ROUTE_COUNT] = {
+	"overlay", "rgb", "format", "obscured", "scaling",
+	"no plane",
+};
+
+struct omap_auto_port {
+	FBDevPtr fbdev;
+	XF86VideoAdaptorPtr textured;
+	pointer textured_port;
+	struct omap_video_info *overlay;
+	enum omap_auto_backend backend;
+
+	Pixel ckey;
+	int autopaint_ckey;
+
+	unsigned long routes[OMAP_ROUTE_COUNT];
+	unsigned long frames[OMAP_AUTO_TEXTURED + 1];
+	unsigned long switches;
+
+	struct omap_hold hold;
+};
+
+static XF86AttributeRec auto_attributes[] = {
+	{XvSettable | XvGettable, 0, 0xffffff, "XV_COLORKEY"},
+	{XvSettable | XvGettable, 0, 1, "XV_AUTOPAINT_COLORKEY"},
+	{XvGettable, OMAP_AUTO_NONE, OMAP_AUTO_TEXTURED,
+	 "XV_OMAP_AUTO_BACKEND"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_AUTO_OVERLAY_FRAMES"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_AUTO_TEXTURED_FRAMES"},
+	{XvGettable, 0, 0x7fffffff, "XV_OMAP_AUTO_SWITCHES"},
+};
+
+static Atom xv_auto_backend, xv_auto_overlay_frames;
+static Atom xv_auto_textured_frames, xv_auto_switches;
+
+static struct omap_video_info *auto_borrow_plane(struct omap_auto_port *port)
+{
+	FBDevPtr fbdev = port->fbdev;
+	struct omap_video_info *vi;
+	int i;
+
+	/* Prefer the last plane, like omap_video_get_free_plane(). */
+	for (i = fbdev->num_video_ports - 1; i >= 0; i--) {
+		vi = get_omap_video_info(fbdev, i);
+		if (vi->borrower || vi->lent || vi->overlay_active
+		    || vi->state != OMAP_STATE_STOPPED)
+			continue;
+
+		vi->borrower = port;
+		vi->ckey = port->ckey;
+		vi->autopaint_ckey = port->autopaint_ckey;
+		vi->dirty = TRUE;
+		port->overlay = vi;
+
+		DebugF("omap/auto: borrowed plane %d\n", vi->id);
+
+		return vi;
+	}
+
+	return NULL;
+}
+
+/**
+ * Give the plane back.  Unless paint is set, the window is assumed to
+ * already show the frame from the other backend, so the colour key is not
+ * painted over.
+ */
+static void auto_return_plane(ScrnInfoPtr screen, struct omap_auto_port *port,
+			      Bool exit, Bool paint)
+{
+	struct omap_video_info *vi = port->overlay;
+
+	if (!vi)
+		return;
+
+	if (!paint)
+		REGION_EMPTY(screen->pScreen, &vi->clip);
+
+	vi->borrower = NULL;
+	port->overlay = NULL;
+	omap_video_stop(screen, vi, exit);
+
+	DebugF("omap/auto: returned plane %d\n", vi->id);
+}
+
+static enum omap_auto_route auto_route(ScrnInfoPtr screen,
+				       struct omap_auto_port *port, int id,
+				       short src_w, short src_h, short dst_w,
+				       short dst_h, short width, short height,
+				       DrawablePtr drawable)
+{
+	FBDevPtr fbdev = port->fbdev;
+	ScreenPtr pScreen = screen->pScreen;
+	WindowPtr window = (WindowPtr) drawable;
+	enum omap_auto_route route = OMAP_ROUTE_OVERLAY;
+	int hscale, vscale;
+
+	switch (id) {
+	case FOURCC_RV16:
+	case FOURCC_RV32:
+		/* Only the overlay takes RGB. */
+		route = OMAP_ROUTE_RGB;
+		break;
+	case FOURCC_YV12:
+	case FOURCC_I420:
+	case FOURCC_YUY2:
+	case FOURCC_UYVY:
+		break;
+	default:
+		return OMAP_ROUTE_FORMAT;
+	}
+
+	if (route == OMAP_ROUTE_OVERLAY) {
+		if (drawable->type != DRAWABLE_WINDOW
+		    || window->visibility != VisibilityUnobscured
+		    || pScreen->GetWindowPixmap(window) !=
+		    pScreen->GetScreenPixmap(pScreen))
+			return OMAP_ROUTE_OBSCURED;
+
+		/* The plane scales the image after it has been rotated
+		 * into panel orientation. */
+		if (fbdev->crtc_lcd && (fbdev->crtc_lcd->rotation &
+					(RR_Rotate_90 | RR_Rotate_270))) {
+			short t;
+
+			t = src_w;
+			src_w = src_h;
+			src_h = t;
+			t = dst_w;
+			dst_w = dst_h;
+			dst_h = t;
+		}
+
+		calc_scaling(src_w, src_h, dst_w, dst_h, &hscale, &vscale);
+		if (width > DummyEncoding.width
+		    || height > DummyEncoding.height || hscale || vscale)
+			return OMAP_ROUTE_SCALING;
+	}
+
+	if (!port->overlay && !auto_borrow_plane(port))
+		return OMAP_ROUTE_NO_PLANE;
+
+	return route;
+}
+
+static int omap_auto_put(ScrnInfoPtr screen, short src_x, short src_y,
+			 short dst_x, short dst_y, short src_w, short src_h,
+			 short dst_w, short dst_h, int id, unsigned char *buf,
+			 short width, short height, Bool sync,
+			 RegionPtr clip_boxes, pointer data,
+			 DrawablePtr drawable)
+{
+	struct omap_auto_port *port = data;
+	enum omap_auto_route route;
+	enum omap_auto_backend backend;
+	int ret;
+
+	if (!omap_output_visible(port->fbdev, drawable)) {
+		omap_hold_frame(&port->hold, src_x, src_y, dst_x, dst_y, src_w,
+				src_h, dst_w, dst_h, id, buf, width, height,
+				drawable);
+		return Success;
+	}
+	omap_hold_drop(&port->hold);
+
+	route = auto_route(screen, port, id, src_w, src_h, dst_w, dst_h,
+			   width, height, drawable);
+
+	if (route == OMAP_ROUTE_OVERLAY || route == OMAP_ROUTE_RGB) {
+		ret = put_image(screen, src_x, src_y, dst_x, dst_y, src_w,
+				src_h, dst_w, dst_h, id, buf, width, height,
+				sync, clip_boxes, port->overlay, drawable);
+		if (ret != Success) {
+			/* Most likely out of video memory. */
+			auto_return_plane(screen, port, TRUE, FALSE);
+			if (route == OMAP_ROUTE_RGB)
+				return ret;
+			route = OMAP_ROUTE_NO_PLANE;
+		}
+	}
+
+	if (route == OMAP_ROUTE_OVERLAY || route == OMAP_ROUTE_RGB) {
+		backend = OMAP_AUTO_OVERLAY;
+	} else {
+		backend = OMAP_AUTO_TEXTURED;
+		ret = port->textured->PutImage(screen, src_x, src_y, dst_x,
+					       dst_y, src_w, src_h, dst_w,
+					       dst_h, id, buf, width, height,
+					       sync, clip_boxes,
+					       port->textured_port, drawable);
+		if (ret != Success)
+			return ret;
+	}
+
+	port->routes[route]++;
+	port->frames[backend]++;
+
+	/* The frame is already on screen through the new backend, so
+	 * retiring the old one now never leaves the window blank. */
+	if (port->backend != backend) {
+		if (port->backend == OMAP_AUTO_OVERLAY)
+			auto_return_plane(screen, port, TRUE, FALSE);
+		else if (port->backend == OMAP_AUTO_TEXTURED)
+			port->textured->StopVideo(screen, port->textured_port,
+						  TRUE);
+
+		if (port->backend != OMAP_AUTO_NONE)
+			port->switches++;
+
+		DebugF("omap/auto: %s -> %s (%s)\n",
+		       port->backend == OMAP_AUTO_OVERLAY ? "overlay" :
+		       port->backend == OMAP_AUTO_TEXTURED ? "textured" : "none",
+		       backend == OMAP_AUTO_OVERLAY ? "overlay" : "textured",
+		       omap_route_names[route]);
+
+		port->backend = backend;
+	}
+
+	return Success;
+}
+
+static void omap_auto_stop(ScrnInfoPtr screen, pointer data, Bool exit)
+{
+	struct omap_auto_port *port = data;
+	int i;
+
+	ENTER();
+
+	omap_hold_drop(&port->hold);
+	auto_return_plane(screen, port, exit, TRUE);
+	port->textured->StopVideo(screen, port->textured_port, exit);
+	port->backend = OMAP_AUTO_NONE;
+
+	if (exit) {
+		DebugF("omap/auto: %lu overlay, %lu textured frames, "
+		       "%lu switches\n", port->frames[OMAP_AUTO_OVERLAY],
+		       port->frames[OMAP_AUTO_TEXTURED], port->switches);
+		for (i = 0; i < OMAP_ROUTE_COUNT; i++)
+			DebugF("omap/auto:   %s: %lu\n", omap_route_names[i],
+			       port->routes[i]);
+	}
+
+	LEAVE();
+}
+
+static void omap_auto_clip_notify(ScrnInfoPtr screen, void *data,
+				  WindowPtr window, int dx, int dy)
+{
+	struct omap_auto_port *port = data;
+
+	if (port->overlay)
+		omap_video_clip_notify(screen, port->overlay, window, dx, dy);
+	omap_hold_kick(&port->hold);
+}
+
+static int omap_auto_get_attribute(ScrnInfoPtr screen, Atom attribute,
+				   INT32 * value, pointer data)
+{
+	struct omap_auto_port *port = data;
+
+	if (attribute == xv_ckey)
+		*value = port->ckey;
+	else if (attribute == xv_autopaint_ckey)
+		*value = port->autopaint_ckey;
+	else if (attribute == xv_auto_backend)
+		*value = port->backend;
+	else if (attribute == xv_auto_overlay_frames)
+		*value = port->frames[OMAP_AUTO_OVERLAY];
+	else if (attribute == xv_auto_textured_frames)
+		*value = port->frames[OMAP_AUTO_TEXTURED];
+	else if (attribute == xv_auto_switches)
+		*value = port->switches;
+	else
+		return port->textured->GetPortAttribute(screen, attribute,
+							value,
+							port->textured_port);
+
+	return Success;
+}
+
+static int omap_auto_set_attribute(ScrnInfoPtr screen, Atom attribute,
+				   INT32 value, pointer data)
+{
+	struct omap_auto_port *port = data;
+
+	if (attribute == xv_ckey) {
+		if (value < 0 || value > 0xffffff)
+			return BadValue;
+		port->ckey = value;
+	} else if (attribute == xv_autopaint_ckey) {
+		if (value != 0 && value != 1)
+			return BadValue;
+		port->autopaint_ckey = value;
+	} else {
+		return port->textured->SetPortAttribute(screen, attribute,
+							value,
+							port->textured_port);
+	}
+
+	if (port->overlay)
+		return omap_video_set_attribute(screen, attribute, value,
+						port->overlay);
+
+	return Success;
+}
+
+static int omap_auto_query_attributes(ScrnInfoPtr screen, int id,
+				      unsigned short *w, unsigned short *h,
+				      int *pitches, int *offsets)
+{
+	FBDevPtr fbdev = screen->driverPrivate;
+	struct omap_auto_port *port = fbdev->auto_adaptor->pPortPrivates[0].ptr;
+
+	/* Both backends lay YUV out the same way. */
+	if (id == FOURCC_RV16 || id == FOURCC_RV32)
+		return omap_video_query_attributes(screen, id, w, h, pitches,
+						   offsets);
+
+	return port->textured->QueryImageAttributes(screen, id, w, h, pitches,
+						    offsets);
+}
+
+static void omap_auto_query_best_size(ScrnInfoPtr screen, Bool motion,
+				      short vid_w, short vid_h, short dst_w,
+				      short dst_h, unsigned int *p_w,
+				      unsigned int *p_h, pointer data)
+{
+	struct omap_auto_port *port = data;
+
+	/* Whatever the textured path can do is always available. */
+	port->textured->QueryBestSize(screen, motion, vid_w, vid_h, dst_w,
+				      dst_h, p_w, p_h, port->textured_port);
+}
+
+static void omap_auto_free_adaptor(XF86VideoAdaptorPtr adapt)
+{
+	int i;
+
+	if (adapt->pPortPrivates)
+		for (i = 0; i < adapt->nPorts; i++)
+			xfree(adapt->pPortPrivates[i].ptr);
+	xfree(adapt->pPortPrivates);
+	xfree(adapt->pAttributes);
+	xfree(adapt->pImages);
+	xfree(adapt);
+}
+
+/**
+ * Set up the auto adaptor on top of the overlay adaptor and a textured
+ * adaptor instance that is not registered with Xv itself.
+ */
+static XF86VideoAdaptorPtr omap_auto_setup_adaptor(ScreenPtr screen,
+						   XF86VideoAdaptorPtr overlay,
+						   XF86VideoAdaptorPtr textured)
+{
+	ScrnInfoPtr xf86screen = xf86Screens[screen->myNum];
+	FBDevPtr fbdev = xf86screen->driverPrivate;
+	XF86VideoAdaptorPtr adapt;
+	struct omap_auto_port *port;
+	int i, n;
+
+	if (!(adapt = xcalloc(1, sizeof(XF86VideoAdaptorRec))))
+		return NULL;
+
+	adapt->type = XvWindowMask | XvInputMask | XvImageMask;
+	adapt->flags = VIDEO_OVERLAID_IMAGES;
+	adapt->name = "OMAP Auto Video";
+	adapt->nEncodings = textured->nEncodings;
+	adapt->pEncodings = textured->pEncodings;
+
+	adapt->nFormats = textured->nFormats;
+	adapt->pFormats = textured->pFormats;
+
+	/* Our own attributes, then the textured colour controls. */
+	adapt->pAttributes = xcalloc(ARRAY_SIZE(auto_attributes) +
+				     textured->nAttributes,
+				     sizeof(XF86AttributeRec));
+	if (!adapt->pAttributes)
+		goto unwind;
+	memcpy(adapt->pAttributes, auto_attributes, sizeof(auto_attributes));
+	memcpy(adapt->pAttributes + ARRAY_SIZE(auto_attributes),
+	       textured->pAttributes,
+	       textured->nAttributes * sizeof(XF86AttributeRec));
+	adapt->nAttributes = ARRAY_SIZE(auto_attributes) + textured->nAttributes;
+
+	/* All textured formats, plus RGB from the overlay. */
+	adapt->pImages = xcalloc(textured->nImages + overlay->nImages,
+				 sizeof(XF86ImageRec));
+	if (!adapt->pImages)
+		goto unwind;
+	memcpy(adapt->pImages, textured->pImages,
+	       textured->nImages * sizeof(XF86ImageRec));
+	n = textured->nImages;
+	for (i = 0; i < overlay->nImages; i++)
+		if (overlay->pImages[i].type == XvRGB)
+			adapt->pImages[n++] = overlay->pImages[i];
+	adapt->nImages = n;
+
+	adapt->PutImage = omap_auto_put;
+	adapt->StopVideo = omap_auto_stop;
+	adapt->GetPortAttribute = omap_auto_get_attribute;
+	adapt->SetPortAttribute = omap_auto_set_attribute;
+	adapt->QueryBestSize = omap_auto_query_best_size;
+	adapt->QueryImageAttributes = omap_auto_query_attributes;
+	adapt->ClipNotify = omap_auto_clip_notify;
+
+	adapt->pPortPrivates = (DevUnion *)
+	    xcalloc(textured->nPorts, sizeof(DevUnion));
+	if (!adapt->pPortPrivates)
+		goto unwind;
+
+	for (i = 0; i < textured->nPorts; i++) {
+		port = xcalloc(1, sizeof(struct omap_auto_port));
+		if (!port)
+			goto unwind;
+
+		port->fbdev = fbdev;
+		port->textured = textured;
+		port->textured_port = textured->pPortPrivates[i].ptr;
+		port->ckey = default_ckey(xf86screen);
+		port->autopaint_ckey = 1;
+
+		adapt->pPortPrivates[i].ptr = (pointer) port;
+		adapt->nPorts++;
+	}
+
+	xv_auto_backend = MAKE_ATOM("XV_OMAP_AUTO_BACKEND");
+	xv_auto_overlay_frames = MAKE_ATOM("XV_OMAP_AUTO_OVERLAY_FRAMES");
+	xv_auto_textured_frames = MAKE_ATOM("XV_OMAP_AUTO_TEXTURED_FRAMES");
+	xv_auto_switches = MAKE_ATOM("XV_OMAP_AUTO_SWITCHES");
+
+	for (i = 0; i < adapt->nPorts; i++) {
+		port = adapt->pPortPrivates[i].ptr;
+		omap_hold_init(&port->hold, fbdev, omap_auto_put,
+			       omap_auto_query_attributes, port);
+	}
+
+	fbdev->auto_adaptor = adapt;
+
+	return adapt;
+
+unwind:
+	omap_auto_free_adaptor(adapt);
+
+	return NULL;
+}
+
 int omap_video_get_active_plane(FBDevPtr fbdev)
 {
 	struct omap_video_info *vi;
@@ -1563,7 +2835,7 @@ int omap_video_get_free_plane(FBDevPtr fbdev)
 
 	for (i = fbdev->num_video_ports - 1; i >= 0; i--) {
 		vi = get_omap_video_info(fbdev, i);
-		if (!vi->overlay_active)
+		if (!vi->overlay_active && !vi->lent)
 			return vi->id;
 	}
 
@@ -1584,11 +2856,179 @@ int omap_video_get_plane_fd(FBDevPtr fbdev, int id)
 	return -1;
 }
 
+/**
+ * Lend a free plane out to scan out a width x height RGB buffer of bpp bits
+ * per pixel, outside of Xv; with alpha, a 32 bpp buffer is ARGB and blended
+ * rather than colour keyed.  Returns the plane's id, with its memory in
+ * *mem and *pitch, or -1 if no plane or not enough memory is free.
+ *
+ * An Xv client putting to the plane calls reclaim, which should give the
+ * plane back with omap_video_return_plane().
+ */
+int omap_video_lend_plane(FBDevPtr fbdev, int width, int height, int bpp,
+			  Bool alpha, void (*reclaim) (pointer data),
+			  pointer data, CARD8 **mem, unsigned long *phys,
+			  int *pitch)
+{
+	struct omap_video_info *vi;
+	int i, num_buffers;
+
+	if (!fbdev->overlay_adaptor)
+		return -1;
+
+	/* Prefer the last plane, like omap_video_get_free_plane(). */
+	for (i = fbdev->num_video_ports - 1; i >= 0; i--) {
+		vi = get_omap_video_info(fbdev, i);
+		if (vi->borrower || vi->lent || vi->overlay_active
+		    || vi->state != OMAP_STATE_STOPPED)
+			continue;
+
+		vi->fourcc = bpp == 16 ? FOURCC_RV16 : FOURCC_RV32;
+		vi->src_w = vi->dst_w = width;
+		vi->src_h = vi->dst_h = height;
+		vi->dst_x = vi->dst_y = 0;
+		vi->hscale = vi->vscale = 0;
+		vi->yuv420 = 0;
+		vi->rotation = RR_Rotate_0;
+		vi->alpha = alpha && bpp == 32;
+
+		/* The client's choice of buffers is for its next video. */
+		num_buffers = vi->num_buffers;
+		vi->num_buffers = 1;
+		vi->dirty = TRUE;
+		if (!setup_plane(vi)) {
+			vi->num_buffers = num_buffers;
+			vi->alpha = FALSE;
+			return -1;
+		}
+		vi->num_buffers = num_buffers;
+
+		vi->lent = TRUE;
+		vi->reclaim = reclaim;
+		vi->reclaim_data = data;
+		*mem = vi->mem;
+		*phys = vi->mem_start;
+		*pitch = vi->dst_pitch;
+
+		DebugF("omap/video: lent plane %d for %dx%d\n", vi->id, width,
+		       height);
+
+		return vi->id;
+	}
+
+	return -1;
+}
+
+static struct omap_video_info *get_lent_plane(FBDevPtr fbdev, int id)
+{
+	struct omap_video_info *vi;
+	int i;
+
+	if (!fbdev->overlay_adaptor)
+		return NULL;
+
+	for (i = 0; i < fbdev->num_video_ports; i++) {
+		vi = get_omap_video_info(fbdev, i);
+		if (vi->id == id && vi->lent)
+			return vi;
+	}
+
+	return NULL;
+}
+
+/**
+ * Show or hide a lent plane over the frame buffer.  Unless it blends, the
+ * frame buffer has to be painted with the returned colour key where it
+ * shows.
+ */
+Pixel omap_video_show_lent_plane(FBDevPtr fbdev, int id, Bool show)
+{
+	struct omap_video_info *vi = get_lent_plane(fbdev, id);
+
+	if (!vi)
+		return 0;
+
+	if (show) {
+		if (!vi->alpha)
+			setup_colorkey(vi, TRUE);
+		enable_plane(vi);
+	} else {
+		disable_plane(vi, TRUE);
+	}
+
+	return vi->ckey;
+}
+
+void omap_video_return_plane(FBDevPtr fbdev, int id)
+{
+	struct omap_video_info *vi = get_lent_plane(fbdev, id);
+
+	if (!vi)
+		return;
+
+	disable_plane(vi, FALSE);
+	vi->lent = FALSE;
+	vi->alpha = FALSE;
+	vi->reclaim = NULL;
+	vi->dirty = TRUE;
+
+	DebugF("omap/video: plane %d returned\n", vi->id);
+}
+
+/**
+ * Show the w x h part of a lent plane's buffer from (src_x, src_y) at
+ * (x, y), unscaled.  Used to clip a plane at the screen edges, which the
+ * hardware won't do itself.
+ */
+Bool omap_video_place_lent_plane(FBDevPtr fbdev, int id, int src_x,
+				 int src_y, int x, int y, int w, int h)
+{
+	struct omap_video_info *vi = get_lent_plane(fbdev, id);
+	struct omapfb_plane_info plane_info;
+	struct fb_var_screeninfo var;
+	Bool reenable = FALSE;
+
+	if (!vi)
+		return FALSE;
+
+	var = vi->var;
+	if (var.xres != w || var.yres != h || var.xoffset != src_x ||
+	    var.yoffset != src_y) {
+		var.xres = w;
+		var.yres = h;
+		var.xoffset = src_x;
+		var.yoffset = src_y;
+		var.activate = FB_ACTIVATE_NOW;
+
+		/* The old output size may be out of scaling range for the
+		 * new input, so go through disabled if need be. */
+		if (ioctl(vi->fd, FBIOPUT_VSCREENINFO, &var) != 0) {
+			if (ioctl(vi->fd, OMAPFB_QUERY_PLANE, &plane_info) != 0)
+				return FALSE;
+			reenable = plane_info.enabled;
+			disable_plane(vi, TRUE);
+			if (ioctl(vi->fd, FBIOPUT_VSCREENINFO, &var) != 0) {
+				ErrorF("omap/video: couldn't set var info\n");
+				return FALSE;
+			}
+		}
+		vi->var = var;
+	}
+
+	if (!move_plane(vi, x, y, w, h))
+		return FALSE;
+
+	if (reenable)
+		enable_plane(vi);
+
+	return TRUE;
+}
+
 Bool fbdev_init_video(ScreenPtr screen)
 {
 	ScrnInfoPtr xf86screen = xf86Screens[screen->myNum];
 	FBDevPtr fbdev = xf86screen->driverPrivate;
-	XF86VideoAdaptorPtr *adaptors = NULL, adaptor;
+	XF86VideoAdaptorPtr *adaptors = NULL, adaptor, textured;
 	int i = 0;
 
 	fbdev->screen = screen;
@@ -1602,6 +3042,11 @@ Bool fbdev_init_video(ScreenPtr screen)
 		i++;
 
 		omap_tvout_init(fbdev);
+
+		/* Large frames get converted in row bands, one thread per
+		 * core. */
+		DebugF("omap/video: %d conversion threads\n",
+		       omap_copy_threads(sysconf(_SC_NPROCESSORS_ONLN)));
 	}
 
 	adaptors = realloc(adaptors, (i + 1) * sizeof(XF86VideoAdaptorPtr));
@@ -1613,6 +3058,29 @@ Bool fbdev_init_video(ScreenPtr screen)
 		i++;
 	}
 
+	/* The auto adaptor goes first, so clients that just take the first
+	 * adaptor get per-frame routing. */
+	if (fbdev->overlay_adaptor && adaptor
+	    && (textured = pvr2dSetupTexturedVideo(screen))) {
+		adaptor = omap_auto_setup_adaptor(screen,
+						  fbdev->overlay_adaptor,
+						  textured);
+		if (!adaptor) {
+			pvr2dFreeTexturedVideo(textured);
+		} else {
+			fbdev->auto_textured = textured;
+			adaptors = realloc(adaptors,
+					   (i + 1) *
+					   sizeof(XF86VideoAdaptorPtr));
+			if (!adaptors)
+				return FALSE;
+			memmove(adaptors + 1, adaptors,
+				i * sizeof(XF86VideoAdaptorPtr));
+			adaptors[0] = adaptor;
+			i++;
+		}
+	}
+
 	xf86XVScreenInit(screen, adaptors, i);
 
 	/* Hook drawable destruction, so we can ignore them if they go away. */
@@ -1638,6 +3106,8 @@ void fbdev_fini_video(ScreenPtr screen)
 	struct omap_video_info *video_info;
 	int i;
 
+	omap_hold_fini_all(fbdev);
+
 	for (i = 0; i < fbdev->num_video_ports; i++) {
 		video_info = get_omap_video_info(fbdev, i);
 
@@ -1649,6 +3119,15 @@ void fbdev_fini_video(ScreenPtr screen)
 	fbdev->video_destroy_pixmap = NULL;
 	fbdev->video_destroy_window = NULL;
 
+	if (fbdev->auto_adaptor)
+		omap_auto_free_adaptor(fbdev->auto_adaptor);
+	fbdev->auto_adaptor = NULL;
+
+	/* Its private textured adaptor isn't Xv's to free. */
+	if (fbdev->auto_textured)
+		pvr2dFreeTexturedVideo(fbdev->auto_textured);
+	fbdev->auto_textured = NULL;
+
 	omap_video_free_adaptor(fbdev, fbdev->overlay_adaptor);
 	fbdev->overlay_adaptor = NULL;
 	fbdev->num_video_ports = 0;
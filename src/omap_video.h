@@ -63,10 +63,62 @@
 		XvTopToBottom \
 	}
 
+#ifndef FOURCC_NV12
+#define FOURCC_NV12 0x3231564e
+#define XVIMAGE_NV12 \
+	{ \
+		FOURCC_NV12, \
+		XvYUV, \
+		LSBFirst, \
+		{'N','V','1','2', \
+		 0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+		12, \
+		XvPlanar, \
+		2, \
+		0, 0, 0, 0, \
+		8, 8, 8, \
+		1, 2, 2, \
+		1, 2, 2, \
+		{'Y','U','V', \
+		 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+		XvTopToBottom \
+	}
+#endif
+
+#ifndef FOURCC_NV21
+#define FOURCC_NV21 0x3132564e
+#define XVIMAGE_NV21 \
+	{ \
+		FOURCC_NV21, \
+		XvYUV, \
+		LSBFirst, \
+		{'N','V','2','1', \
+		 0x00,0x00,0x00,0x10,0x80,0x00,0x00,0xAA,0x00,0x38,0x9B,0x71}, \
+		12, \
+		XvPlanar, \
+		2, \
+		0, 0, 0, 0, \
+		8, 8, 8, \
+		1, 2, 2, \
+		1, 2, 2, \
+		{'Y','V','U', \
+		 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0}, \
+		XvTopToBottom \
+	}
+#endif
+
 void omap_video_stop(ScrnInfoPtr screen, pointer data, Bool exit);
 int omap_video_get_active_plane(FBDevPtr fbdev);
 int omap_video_get_free_plane(FBDevPtr fbdev);
 int omap_video_get_plane_fd(FBDevPtr fbdev, int id);
+int omap_video_lend_plane(FBDevPtr fbdev, int width, int height, int bpp,
+			  Bool alpha, void (*reclaim) (pointer data),
+			  pointer data, CARD8 **mem, unsigned long *phys,
+			  int *pitch);
+Pixel omap_video_show_lent_plane(FBDevPtr fbdev, int id, Bool show);
+Bool omap_video_place_lent_plane(FBDevPtr fbdev, int id, int src_x,
+				 int src_y, int x, int y, int w, int h);
+void omap_video_return_plane(FBDevPtr fbdev, int id);
 Bool fbdev_init_video(ScreenPtr screen);
 void fbdev_fini_video(ScreenPtr screen);
 
@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * Standalone throughput benchmark for the omap_copy_* overlay converters,
+ * so conversion speed can be measured without an X server or a device.
+ *
+ * Every converter is run over a set of frame sizes, destination pitches
+ * and scale factors with each available row kernel set; the bilinear_* and
+ * box_* rows measure the filtered downscalers against the nearest
+ * neighbour scale_* rows at the same factors.  Each case is run with 1, 2
+ * and 4 conversion threads to show how row bands scale.  Results are
+ * printed as CSV on stdout.  With -v the output of every kernel set is
+ * also compared byte for byte with the C reference, including sources
+ * cropped at odd offsets.
+ *
+ * The nv12_* rows are not overlay converters but the SGX adaptor's
+ * NV12 upload: nv12_upload splits the chroma straight into the source
+ * surfaces, nv12_repack_i420 is a client repacking to I420 first and the
+ * I420 upload after it, which is what NV12 video cost before.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "omap_video_types.h"
+#include "omap_video_formats.h"
+
+/* The converters log through the server; there is none here. */
+void ErrorF(const char *f, ...)
+{
+	va_list args;
+
+	va_start(args, f);
+	vfprintf(stderr, f, args);
+	va_end(args);
+}
+
+enum bench_kind {
+	BENCH_PACKED,
+	BENCH_PLANAR,
+	BENCH_YUV420,
+	BENCH_16,
+	BENCH_32,
+	BENCH_NV12,
+	BENCH_NV12_REPACK,
+};
+
+struct bench_converter {
+	const char *name;
+	enum bench_kind kind;
+	int id;			/* FOURCC_*, YUV only. */
+	Bool scale;
+	int filter;		/* enum omap_scale_filter, scale only. */
+	int randr;		/* RR_Rotate_*, 0 for unrotated. */
+};
+
+static const struct bench_converter converters[] = {
+	{.name = "packed", .kind = BENCH_PACKED, .id = FOURCC_YUY2},
+	{.name = "packed_rot90", .kind = BENCH_PACKED, .id = FOURCC_YUY2,
+	 .randr = RR_Rotate_90},
+	{.name = "scale_packed", .kind = BENCH_PACKED, .id = FOURCC_YUY2,
+	 .scale = TRUE},
+	{.name = "bilinear_packed", .kind = BENCH_PACKED, .id = FOURCC_YUY2,
+	 .scale = TRUE, .filter = OMAP_SCALE_BILINEAR},
+	{.name = "box_packed", .kind = BENCH_PACKED, .id = FOURCC_YUY2,
+	 .scale = TRUE, .filter = OMAP_SCALE_BOX},
+	{.name = "planar_i420", .kind = BENCH_PLANAR, .id = FOURCC_I420},
+	{.name = "planar_yv12", .kind = BENCH_PLANAR, .id = FOURCC_YV12},
+	{.name = "planar_rot90", .kind = BENCH_PLANAR, .id = FOURCC_I420,
+	 .randr = RR_Rotate_90},
+	{.name = "planar_rot180", .kind = BENCH_PLANAR, .id = FOURCC_I420,
+	 .randr = RR_Rotate_180},
+	{.name = "planar_rot270", .kind = BENCH_PLANAR, .id = FOURCC_I420,
+	 .randr = RR_Rotate_270},
+	{.name = "scale_planar", .kind = BENCH_PLANAR, .id = FOURCC_I420,
+	 .scale = TRUE},
+	{.name = "bilinear_planar", .kind = BENCH_PLANAR, .id = FOURCC_I420,
+	 .scale = TRUE, .filter = OMAP_SCALE_BILINEAR},
+	{.name = "box_planar", .kind = BENCH_PLANAR, .id = FOURCC_I420,
+	 .scale = TRUE, .filter = OMAP_SCALE_BOX},
+	{.name = "yuv420", .kind = BENCH_YUV420, .id = FOURCC_I420},
+	{.name = "rgb16", .kind = BENCH_16},
+	{.name = "rgb16_rot90", .kind = BENCH_16, .randr = RR_Rotate_90},
+	{.name = "scale_rgb16", .kind = BENCH_16, .scale = TRUE},
+	{.name = "rgb32", .kind = BENCH_32},
+	{.name = "rgb32_rot90", .kind = BENCH_32, .randr = RR_Rotate_90},
+	{.name = "scale_rgb32", .kind = BENCH_32, .scale = TRUE},
+	{.name = "nv12_upload", .kind = BENCH_NV12},
+	{.name = "nv12_repack_i420", .kind = BENCH_NV12_REPACK},
+};
+
+static const struct {
+	int w, h;
+} sizes[] = {
+	{320, 240},
+	{480, 272},
+	{640, 480},
+	{800, 480},
+	{720, 576},
+	{1280, 720},
+};
+
+/* Downscale factors for the scale converters, in 1/4 steps. */
+static const int scales[] = { 6, 8, 16 };
+
+/* Extra destination pitch, to catch kernels that only like tight rows. */
+static const int pitch_pads[] = { 0, 64 };
+
+/*
+ * Source crop offsets.  Only the first is benchmarked; -v checks the rest
+ * too, odd ones included, as clients often show part of a larger image.
+ */
+static const struct {
+	int left, top;
+} offsets[] = {
+	{0, 0},
+	{2, 2},
+	{3, 1},
+};
+
+static const char *impls[] = { "c", "neon" };
+static const int thread_counts[] = { 1, 2, 4 };
+
+struct bench_frame {
+	int src_w, src_h, dst_w, dst_h;
+	int left, top, img_w, img_h;
+	int src_pitch, src_pitch2, dst_pitch, dst_pitch2;
+	int src_size, dst_size;
+	CARD8 *src, *dst;
+	CARD8 *tmp;			/* Client side I420 copy, repacking. */
+};
+
+static int src_layout(const struct bench_converter *c, int w, int *pitch2)
+{
+	*pitch2 = 0;
+
+	switch (c->kind) {
+	case BENCH_PACKED:
+		return ((w + 1) & ~1) << 1;
+	case BENCH_PLANAR:
+	case BENCH_YUV420:
+		*pitch2 = ((((w + 3) & ~3) >> 1) + 3) & ~3;
+		return (w + 3) & ~3;
+	case BENCH_16:
+		return w << 1;
+	case BENCH_32:
+		return w << 2;
+	case BENCH_NV12:
+	case BENCH_NV12_REPACK:
+		*pitch2 = (w + 3) & ~3;
+		return (w + 3) & ~3;
+	}
+
+	return 0;
+}
+
+static int dst_row_bytes(const struct bench_converter *c, int w)
+{
+	switch (c->kind) {
+	case BENCH_YUV420:
+		return w * 3 / 2;
+	case BENCH_32:
+		return w << 2;
+	case BENCH_NV12:
+	case BENCH_NV12_REPACK:
+		return w;
+	default:
+		return ((w + 1) & ~1) << 1;
+	}
+}
+
+/* Row by row, as initSrcSurf() uploads a plane. */
+static void upload_plane(CARD8 * dst, int dstPitch, const CARD8 * src,
+			 int srcPitch, int w, int h)
+{
+	for (; h > 0; h--, dst += dstPitch, src += srcPitch)
+		memcpy(dst, src, w);
+}
+
+/* Fill the three SGX source surfaces from an NV12 frame. */
+static void run_nv12(const struct bench_converter *c, struct bench_frame *f)
+{
+	int pitch = f->src_pitch, cw = (f->src_w + 1) >> 1;
+	int ch = (f->src_h + 1) >> 1, w2 = (f->img_w + 1) & ~1;
+	int h2 = (f->img_h + 1) & ~1, cpitch = ((w2 >> 1) + 3) & ~3;
+	CARD8 *uv = f->src + pitch * h2;
+	CARD8 *u = f->dst + f->dst_pitch * f->src_h;
+	CARD8 *v = u + f->dst_pitch2 * ch;
+	CARD8 *tu = f->tmp + pitch * h2, *tv = tu + cpitch * (h2 >> 1);
+
+	if (c->kind == BENCH_NV12) {
+		upload_plane(f->dst, f->dst_pitch,
+			     f->src + f->top * pitch + f->left, pitch,
+			     f->src_w, f->src_h);
+		omap_copy_deinterleave(uv + (f->top >> 1) * pitch +
+				       (f->left & ~1), u, v, pitch,
+				       f->dst_pitch2, cw, ch);
+		return;
+	}
+
+	/* The client converts the whole frame, luma included. */
+	upload_plane(f->tmp, pitch, f->src, pitch, f->img_w, f->img_h);
+	omap_copy_deinterleave(uv, tu, tv, pitch, cpitch, w2 >> 1, h2 >> 1);
+
+	upload_plane(f->dst, f->dst_pitch, f->tmp + f->top * pitch + f->left,
+		     pitch, f->src_w, f->src_h);
+	upload_plane(u, f->dst_pitch2,
+		     tu + (f->top >> 1) * cpitch + (f->left >> 1), cpitch, cw,
+		     ch);
+	upload_plane(v, f->dst_pitch2,
+		     tv + (f->top >> 1) * cpitch + (f->left >> 1), cpitch, cw,
+		     ch);
+}
+
+static void run(const struct bench_converter *c, struct bench_frame *f)
+{
+	Bool hscale = c->scale, vscale = c->scale;
+	int randr = c->randr ? c->randr : RR_Rotate_0;
+
+	switch (c->kind) {
+	case BENCH_PACKED:
+		if (c->filter)
+			omap_copy_filter_packed(c->filter, hscale, vscale,
+						f->src, f->dst, randr,
+						f->src_pitch, f->dst_pitch,
+						f->src_w, f->src_h, f->left,
+						f->top, f->img_w, f->img_h,
+						c->id, f->dst_w, f->dst_h);
+		else if (c->scale)
+			omap_copy_scale_packed(hscale, vscale, f->src, f->dst,
+					       randr, f->src_pitch,
+					       f->dst_pitch, f->src_w,
+					       f->src_h, f->left, f->top,
+					       f->img_w, f->img_h, c->id,
+					       f->dst_w, f->dst_h);
+		else
+			omap_copy_packed(f->src, f->dst, randr,
+					 f->src_pitch, f->dst_pitch, f->src_w,
+					 f->src_h, f->left, f->top, f->img_w,
+					 f->img_h, c->id);
+		break;
+	case BENCH_PLANAR:
+		if (c->filter)
+			omap_copy_filter_planar(c->filter, hscale, vscale,
+						f->src, f->dst, randr,
+						f->src_pitch, f->src_pitch2,
+						f->dst_pitch, f->src_w,
+						f->src_h, f->left, f->top,
+						f->img_w, f->img_h, c->id,
+						f->dst_w, f->dst_h);
+		else if (c->scale)
+			omap_copy_scale_planar(hscale, vscale, f->src, f->dst,
+					       randr, f->src_pitch,
+					       f->src_pitch2, f->dst_pitch,
+					       f->src_w, f->src_h, f->left,
+					       f->top, f->img_w, f->img_h,
+					       c->id, f->dst_w, f->dst_h);
+		else
+			omap_copy_planar(f->src, f->dst, randr,
+					 f->src_pitch, f->src_pitch2,
+					 f->dst_pitch, f->src_w, f->src_h,
+					 f->left, f->top, f->img_w, f->img_h,
+					 c->id);
+		break;
+	case BENCH_YUV420:
+		omap_copy_yuv420(f->src, f->dst, randr, f->src_pitch,
+				 f->src_pitch2, f->dst_pitch, f->src_w,
+				 f->src_h, f->left, f->top, f->img_w,
+				 f->img_h, c->id);
+		break;
+	case BENCH_16:
+		if (c->scale)
+			omap_copy_scale_16(hscale, vscale, f->src, f->dst,
+					   randr, f->src_pitch,
+					   f->dst_pitch, f->src_w, f->src_h,
+					   f->left, f->top, f->img_w, f->img_h,
+					   f->dst_w, f->dst_h);
+		else
+			omap_copy_16(f->src, f->dst, randr, f->src_pitch,
+				     f->dst_pitch, f->src_w, f->src_h,
+				     f->left, f->top, f->img_w, f->img_h);
+		break;
+	case BENCH_32:
+		if (c->scale)
+			omap_copy_scale_32(hscale, vscale, f->src, f->dst,
+					   randr, f->src_pitch,
+					   f->dst_pitch, f->src_w, f->src_h,
+					   f->left, f->top, f->img_w, f->img_h,
+					   f->dst_w, f->dst_h);
+		else
+			omap_copy_32(f->src, f->dst, randr, f->src_pitch,
+				     f->dst_pitch, f->src_w, f->src_h,
+				     f->left, f->top, f->img_w, f->img_h);
+		break;
+	case BENCH_NV12:
+	case BENCH_NV12_REPACK:
+		run_nv12(c, f);
+		break;
+	}
+}
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static Bool setup_frame(const struct bench_converter *c,
+			struct bench_frame *f, int w, int h, int left,
+			int top, int scale, int pad)
+{
+	CARD32 seed = 0x2545f491;
+	Bool swap = c->randr == RR_Rotate_90 || c->randr == RR_Rotate_270;
+	int out_w = swap ? h : w, out_h = swap ? w : h;
+	int i;
+
+	/* w x h is cropped from a larger image at left, top; dst is in output
+	 * orientation, so transposed for 90 and 270. */
+	f->src_w = w;
+	f->src_h = h;
+	f->left = left;
+	f->top = top;
+	f->img_w = w + left;
+	f->img_h = h + top;
+	f->dst_w = c->scale ? (out_w * 4 / scale) & ~1 : out_w;
+	f->dst_h = c->scale ? out_h * 4 / scale : out_h;
+	f->src_pitch = src_layout(c, f->img_w, &f->src_pitch2);
+	f->dst_pitch = dst_row_bytes(c, out_w) + pad;
+	f->dst_pitch2 = 0;
+	f->tmp = NULL;
+
+	f->src_size = f->src_pitch * f->img_h;
+	if (f->src_pitch2)
+		f->src_size += f->src_pitch2 * f->img_h;
+	f->dst_size = f->dst_pitch * out_h;
+
+	/* NV12 has one chroma plane of (h + 1) / 2 lines; the surfaces two,
+	 * and a repacking client an I420 frame. */
+	if (c->kind == BENCH_NV12 || c->kind == BENCH_NV12_REPACK) {
+		int h2 = (f->img_h + 1) & ~1;
+
+		f->src_size = f->src_pitch * (h2 + (h2 >> 1));
+		f->dst_pitch2 = ((((w + 1) >> 1) + 3) & ~3) + pad;
+		f->dst_size += f->dst_pitch2 * ((h + 1) >> 1) * 2;
+		if (c->kind == BENCH_NV12_REPACK) {
+			int cpitch = ((((f->img_w + 1) >> 1) + 3) & ~3);
+
+			f->tmp = malloc((f->src_pitch + cpitch) * h2);
+			if (!f->tmp)
+				return FALSE;
+		}
+	}
+
+	f->src = malloc(f->src_size);
+	f->dst = malloc(f->dst_size);
+	if (!f->src || !f->dst)
+		return FALSE;
+
+	for (i = 0; i < f->src_size; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		f->src[i] = seed;
+	}
+
+	return TRUE;
+}
+
+static void free_frame(struct bench_frame *f)
+{
+	free(f->src);
+	free(f->dst);
+	free(f->tmp);
+	f->src = f->dst = f->tmp = NULL;
+}
+
+/**
+ * Benchmark one converter on one frame layout with every kernel set and
+ * thread count.  Returns the number of runs whose output differs from
+ * single-threaded C.
+ */
+static int bench_case(const struct bench_converter *c, int w, int h,
+		      int left, int top, int scale, int pad, const char *only,
+		      int threads, double min_time, Bool verify)
+{
+	struct bench_frame f;
+	CARD8 *ref = NULL;
+	int dst_bytes, failures = 0;
+	int i, t, n;
+
+	if (!setup_frame(c, &f, w, h, left, top, scale, pad) ||
+	    (verify && !(ref = malloc(f.dst_size)))) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	if (verify) {
+		omap_copy_select("c");
+		omap_copy_threads(1);
+		memset(f.dst, 0x5a, f.dst_size);
+		run(c, &f);
+		memcpy(ref, f.dst, f.dst_size);
+	}
+
+	dst_bytes = dst_row_bytes(c, f.dst_w) * f.dst_h;
+	if (f.dst_pitch2)
+		dst_bytes += ((f.dst_w + 1) >> 1) * ((f.dst_h + 1) >> 1) * 2;
+
+	for (i = 0; i < ARRAY_SIZE(impls); i++) {
+		if (only && strcmp(only, impls[i]))
+			continue;
+		if (!omap_copy_select(impls[i]))
+			continue;
+
+		for (t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+			double start, elapsed;
+			long frames = 0;
+
+			if (threads && threads != thread_counts[t])
+				continue;
+			n = omap_copy_threads(thread_counts[t]);
+			if (n != thread_counts[t])
+				continue;
+
+			if (verify) {
+				memset(f.dst, 0x5a, f.dst_size);
+				run(c, &f);
+				if (memcmp(ref, f.dst, f.dst_size)) {
+					fprintf(stderr, "MISMATCH: %s %s %d "
+						"threads %dx%d+%d+%d -> "
+						"%dx%d pitch %d\n", c->name,
+						impls[i], n, f.src_w, f.src_h,
+						f.left, f.top, f.dst_w,
+						f.dst_h, f.dst_pitch);
+					failures++;
+				}
+			}
+
+			/* Warm up, then run until min_time has passed. */
+			run(c, &f);
+			start = now();
+			do {
+				run(c, &f);
+				frames++;
+				elapsed = now() - start;
+			} while (elapsed < min_time);
+
+			printf("%s,%s,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%ld,"
+			       "%.4f,%.1f,%.1f\n", c->name, impls[i], n,
+			       f.src_w, f.src_h, f.left, f.top, f.dst_w,
+			       f.dst_h, f.dst_pitch,
+			       f.src_size, dst_bytes, frames, elapsed,
+			       (double)(f.src_size + dst_bytes) * frames /
+			       elapsed / 1e6, frames / elapsed);
+		}
+	}
+
+	free(ref);
+	free_frame(&f);
+
+	return failures;
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr,
+		"usage: %s [-c converter] [-i c|neon] [-j 1|2|4] "
+		"[-t seconds] [-v]\n"
+		"  -c  only benchmark converters whose name starts so\n"
+		"  -i  only benchmark this row kernel set\n"
+		"  -j  only benchmark with this many threads\n"
+		"  -t  minimum time per case (default 0.2)\n"
+		"  -v  check every kernel set against the C reference,\n"
+		"      also with cropped sources\n",
+		argv0);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char *only = NULL, *name = NULL;
+	double min_time = 0.2;
+	Bool verify = FALSE;
+	int threads = 0, failures = 0, noffsets;
+	int opt, c, s, o, k, p;
+
+	while ((opt = getopt(argc, argv, "c:i:j:t:vh")) != -1) {
+		switch (opt) {
+		case 'c':
+			name = optarg;
+			break;
+		case 'i':
+			only = optarg;
+			break;
+		case 'j':
+			threads = atoi(optarg);
+			break;
+		case 't':
+			min_time = atof(optarg);
+			break;
+		case 'v':
+			verify = TRUE;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	/* mb_s counts source reads plus destination writes. */
+	printf("converter,impl,threads,src_w,src_h,left,top,dst_w,dst_h,"
+	       "dst_pitch,src_bytes,dst_bytes,frames,seconds,mb_s,fps\n");
+
+	noffsets = verify ? ARRAY_SIZE(offsets) : 1;
+
+	for (c = 0; c < ARRAY_SIZE(converters); c++) {
+		int nscales = converters[c].scale ? ARRAY_SIZE(scales) : 1;
+
+		if (name && strncmp(converters[c].name, name, strlen(name)))
+			continue;
+
+		for (s = 0; s < ARRAY_SIZE(sizes); s++)
+			for (o = 0; o < noffsets; o++)
+				for (k = 0; k < nscales; k++)
+					for (p = 0; p < ARRAY_SIZE(pitch_pads);
+					     p++)
+						failures +=
+						    bench_case(&converters[c],
+							       sizes[s].w,
+							       sizes[s].h,
+							       offsets[o].left,
+							       offsets[o].top,
+							       scales[k],
+							       pitch_pads[p],
+							       only, threads,
+							       min_time,
+							       verify);
+	}
+
+	if (verify)
+		fprintf(stderr, "%d mismatches\n", failures);
+
+	return failures ? 1 : 0;
+}
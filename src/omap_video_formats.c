@@ -21,19 +21,823 @@
  */
 
 /**
- * None of the functions in this file need to deal with rotation:
- * we can rotate on scanout from the LCD controller, so all our
- * copies are unrotated, as rotating while copying is a horrific
- * speed hit.
+ * The video planes scan out unrotated, so when the screen is rotated the
+ * converters rotate while copying: randr is the rotation to apply, and
+ * the output is in scanout orientation.  Unrotated copies keep their
+ * straight-line fast paths.
  */
 
 #ifdef HAVE_KDRIVE_CONFIG_H
 #include <kdrive-config.h>
 #endif
 
-#include "fbdev.h"
-#include "fourcc.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <elf.h>
+#include <pthread.h>
+#include <signal.h>
+
+#include "omap_video_types.h"
 #include "omap_video_formats.h"
+#include "omap_video_kernels.h"
+
+#ifndef HWCAP_NEON
+#define HWCAP_NEON (1 << 12)
+#endif
+
+static void copy_row_c(CARD8 * dst, const CARD8 * src, int bytes)
+{
+	memcpy(dst, src, bytes);
+}
+
+static void planar_row_c(CARD8 * dst, const CARD8 * y, const CARD8 * c1,
+			 const CARD8 * c2, int pairs)
+{
+	CARD32 *d = (CARD32 *) dst;
+
+	/* Byte loads: y is unaligned for odd left offsets. */
+	while (pairs--) {
+		*d++ = y[0] | (*c1 << 8) | (y[1] << 16) | ((CARD32) *c2 << 24);
+		y += 2;
+		c1++;
+		c2++;
+	}
+}
+
+static void yuv420_row_c(CARD8 * dst, const CARD8 * y, const CARD8 * c,
+			 int blocks)
+{
+	while (blocks--) {
+		dst[0] = y[0];
+		dst[1] = c[0];
+		dst[2] = c[1];
+		dst[3] = y[1];
+		dst[4] = y[3];
+		dst[5] = y[2];
+		dst += 6;
+		y += 4;
+		c += 2;
+	}
+}
+
+static void deinterleave_row_c(CARD8 * d1, CARD8 * d2, const CARD8 * src,
+			       int pairs)
+{
+	while (pairs--) {
+		*d1++ = *src++;
+		*d2++ = *src++;
+	}
+}
+
+static void blend_row_c(CARD8 * dst, const CARD8 * a, const CARD8 * b,
+			int f, int bytes)
+{
+	int fa = 256 - f;
+
+	while (bytes--)
+		*dst++ = (*a++ * fa + *b++ * f + 128) >> 8;
+}
+
+static void transpose_16_c(CARD8 * dst, int dstPitch, const CARD8 * src,
+			   int srcPitch, int w, int h)
+{
+	int x, y;
+
+	for (x = 0; x < w; x++) {
+		CARD16 *d = (CARD16 *) (dst + x * dstPitch);
+		const CARD8 *s = src + x * 2;
+
+		for (y = 0; y < h; y++, s += srcPitch)
+			*d++ = *(const CARD16 *)s;
+	}
+}
+
+static void transpose_32_c(CARD8 * dst, int dstPitch, const CARD8 * src,
+			   int srcPitch, int w, int h)
+{
+	int x, y;
+
+	for (x = 0; x < w; x++) {
+		CARD32 *d = (CARD32 *) (dst + x * dstPitch);
+		const CARD8 *s = src + x * 4;
+
+		for (y = 0; y < h; y++, s += srcPitch)
+			*d++ = *(const CARD32 *)s;
+	}
+}
+
+const struct omap_copy_kernels omap_copy_kernels_c = {
+	.name = "c",
+	.copy_row = copy_row_c,
+	.planar_row = planar_row_c,
+	.blend_row = blend_row_c,
+	.yuv420_row = yuv420_row_c,
+	.deinterleave_row = deinterleave_row_c,
+	.transpose_16 = transpose_16_c,
+	.transpose_32 = transpose_32_c,
+};
+
+static const struct omap_copy_kernels *kernels;
+
+#ifdef HAVE_NEON
+static Bool cpu_has_neon(void)
+{
+#if defined(__aarch64__)
+	return TRUE;
+#else
+	unsigned long auxv[2];
+	Bool ret = FALSE;
+	int fd;
+
+	fd = open("/proc/self/auxv", O_RDONLY);
+	if (fd < 0)
+		return FALSE;
+
+	while (read(fd, auxv, sizeof(auxv)) == sizeof(auxv)) {
+		if (auxv[0] == AT_HWCAP) {
+			ret = !!(auxv[1] & HWCAP_NEON);
+			break;
+		}
+	}
+
+	close(fd);
+
+	return ret;
+#endif
+}
+
+/**
+ * Run the kernels over a few pseudo-random rows of awkward lengths and
+ * compare against the C reference, so a miscompiled SIMD kernel costs
+ * speed rather than corrupting video.
+ */
+static Bool kernels_match_c(const struct omap_copy_kernels *k)
+{
+	enum { ROW = 700 };
+	static const int lengths[] = { 1, 15, 16, 17, 63, 64, 65, 333 };
+	/* Word arrays, so the C reference sees aligned rows. */
+	CARD32 planes[3][ROW / 4], ref32[ROW / 2 + 1], out32[ROW / 2 + 1];
+	CARD8 *src[3], *ref = (CARD8 *) ref32, *out = (CARD8 *) out32;
+	CARD32 seed = 0x12345678;
+	int i, j, n;
+
+	for (i = 0; i < 3; i++) {
+		src[i] = (CARD8 *) planes[i];
+		for (j = 0; j < ROW; j++) {
+			seed = seed * 1103515245 + 12345;
+			src[i][j] = seed >> 16;
+		}
+	}
+
+	for (i = 0; i < ARRAY_SIZE(lengths); i++) {
+		n = lengths[i];
+
+		memset(ref32, 0xa5, sizeof(ref32));
+		memset(out32, 0xa5, sizeof(out32));
+		omap_copy_kernels_c.copy_row(ref + 1, src[0] + 1, n * 2);
+		k->copy_row(out + 1, src[0] + 1, n * 2);
+		if (memcmp(ref32, out32, sizeof(ref32)))
+			return FALSE;
+
+		memset(ref32, 0xa5, sizeof(ref32));
+		memset(out32, 0xa5, sizeof(out32));
+		omap_copy_kernels_c.planar_row(ref, src[0], src[1], src[2], n);
+		k->planar_row(out, src[0], src[1], src[2], n);
+		if (memcmp(ref32, out32, sizeof(ref32)))
+			return FALSE;
+
+		memset(ref32, 0xa5, sizeof(ref32));
+		memset(out32, 0xa5, sizeof(out32));
+		omap_copy_kernels_c.blend_row(ref + 1, src[0], src[1] + 1,
+					      n & 0xff ? n & 0xff : 1, n * 2);
+		k->blend_row(out + 1, src[0], src[1] + 1,
+			     n & 0xff ? n & 0xff : 1, n * 2);
+		if (memcmp(ref32, out32, sizeof(ref32)))
+			return FALSE;
+
+		memset(ref32, 0xa5, sizeof(ref32));
+		memset(out32, 0xa5, sizeof(out32));
+		omap_copy_kernels_c.yuv420_row(ref + 2, src[0], src[1], n / 2);
+		k->yuv420_row(out + 2, src[0], src[1], n / 2);
+		if (memcmp(ref32, out32, sizeof(ref32)))
+			return FALSE;
+
+		memset(ref32, 0xa5, sizeof(ref32));
+		memset(out32, 0xa5, sizeof(out32));
+		omap_copy_kernels_c.deinterleave_row(ref + 1, ref + 401,
+						     src[0] + 1, n);
+		k->deinterleave_row(out + 1, out + 401, src[0] + 1, n);
+		if (memcmp(ref32, out32, sizeof(ref32)))
+			return FALSE;
+
+		/* Blocks of up to 20x17 pixels out of 40 byte source lines,
+		 * written bottom up as for a 90 degree rotation. */
+		memset(ref32, 0xa5, sizeof(ref32));
+		memset(out32, 0xa5, sizeof(out32));
+		omap_copy_kernels_c.transpose_16(ref + (n % 20) * 40, -40,
+						 src[0], 40, n % 20 + 1, 17 - i);
+		k->transpose_16(out + (n % 20) * 40, -40, src[0], 40,
+				n % 20 + 1, 17 - i);
+		if (memcmp(ref32, out32, sizeof(ref32)))
+			return FALSE;
+
+		memset(ref32, 0xa5, sizeof(ref32));
+		memset(out32, 0xa5, sizeof(out32));
+		omap_copy_kernels_c.transpose_32(ref + (n % 10) * 80, -80,
+						 src[0], 40, n % 10 + 1, 17 - i);
+		k->transpose_32(out + (n % 10) * 80, -80, src[0], 40,
+				n % 10 + 1, 17 - i);
+		if (memcmp(ref32, out32, sizeof(ref32)))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+#endif
+
+/**
+ * Pick the fastest row kernels the CPU supports.  impl may name a kernel
+ * set ("c", "neon") to force it; returns FALSE if that one is unavailable.
+ */
+Bool omap_copy_select(const char *impl)
+{
+	const struct omap_copy_kernels *k = &omap_copy_kernels_c;
+
+#ifdef HAVE_NEON
+	if ((!impl || !strcmp(impl, omap_copy_kernels_neon.name))
+	    && cpu_has_neon()) {
+		if (kernels_match_c(&omap_copy_kernels_neon))
+			k = &omap_copy_kernels_neon;
+		else
+			ErrorF("omap/video: NEON converters disagree with the C "
+			       "reference, not using them\n");
+	}
+#endif
+
+	if (impl && strcmp(impl, k->name))
+		return FALSE;
+
+	if (kernels != k)
+		DebugF("omap/video: using %s converters\n", k->name);
+	kernels = k;
+
+	return TRUE;
+}
+
+const char *omap_copy_impl(void)
+{
+	if (!kernels)
+		omap_copy_select(NULL);
+
+	return kernels->name;
+}
+
+static _X_INLINE const struct omap_copy_kernels *get_kernels(void)
+{
+	if (!kernels)
+		omap_copy_select(NULL);
+
+	return kernels;
+}
+
+/*
+ * Row bands.  Large frames are converted by a small pool of threads that
+ * take bands of output rows in turn, the calling thread included.  Every
+ * converter works out any output row from absolute source coordinates, so
+ * bands are independent and the output is the same whatever the split.
+ */
+#define BAND_MAX_THREADS 4
+#define BAND_MIN_BYTES (16 * 1024)
+
+/* One conversion, as seen by its rows function.  Filtered copies get
+ * tmp_size bytes of tmp and acc_size words of acc per band. */
+struct band_job {
+	void (*rows) (const struct band_job * j, int band, int y0, int y1);
+	const struct omap_copy_kernels *k;
+	const CARD8 *src, *c1, *c2;	/* Packed or luma; planar chroma. */
+	int srcPitch, srcPitch2;
+	CARD8 *dst, *dst2;		/* dst2: second plane, deinterleaving. */
+	int dstPitch;
+	int w;				/* Output row, in the rows' units. */
+	int left, top;
+	int xinc, yinc;
+	int lo;				/* UYVY rather than YUY2. */
+	Bool hscale, vscale, contig;
+	int filter, srcW, chromaW;
+	const struct filter_map *hy, *hc, *vy, *vc;
+	CARD8 *tmp;
+	CARD32 *acc;
+	int tmp_size, acc_size;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t work, done;
+	pthread_t thread[BAND_MAX_THREADS - 1];
+	int threads;			/* In use, counting the caller. */
+	int started;
+	unsigned int generation;
+	const struct band_job *job;
+	int rows, height, next, active;
+} pool = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.work = PTHREAD_COND_INITIALIZER,
+	.done = PTHREAD_COND_INITIALIZER,
+	.threads = 1,
+};
+
+/* Convert bands of the current job until there are none left; called
+ * with the pool locked. */
+static void take_bands(void)
+{
+	const struct band_job *j = pool.job;
+	int y0, y1, band;
+
+	while (pool.next < pool.rows) {
+		y0 = pool.next;
+		y1 = min(y0 + pool.height, pool.rows);
+		band = y0 / pool.height;
+		pool.next = y1;
+		pool.active++;
+		pthread_mutex_unlock(&pool.lock);
+
+		j->rows(j, band, y0, y1);
+
+		pthread_mutex_lock(&pool.lock);
+		if (!--pool.active && pool.next >= pool.rows)
+			pthread_cond_signal(&pool.done);
+	}
+}
+
+static void *band_thread(void *data)
+{
+	unsigned int seen;
+
+	pthread_mutex_lock(&pool.lock);
+	seen = pool.generation;
+	for (;;) {
+		while (pool.generation == seen)
+			pthread_cond_wait(&pool.work, &pool.lock);
+		seen = pool.generation;
+		if (pool.job)
+			take_bands();
+	}
+
+	return NULL;
+}
+
+int omap_copy_threads(int n)
+{
+	sigset_t all, saved;
+
+	if (n < 1)
+		n = 1;
+	if (n > BAND_MAX_THREADS)
+		n = BAND_MAX_THREADS;
+
+	/* Workers stay around once started; signals stay with the caller. */
+	pthread_mutex_lock(&pool.lock);
+	sigfillset(&all);
+	pthread_sigmask(SIG_BLOCK, &all, &saved);
+	while (pool.started < n - 1 &&
+	       !pthread_create(&pool.thread[pool.started], NULL, band_thread,
+			       NULL))
+		pool.started++;
+	pthread_sigmask(SIG_SETMASK, &saved, NULL);
+	pool.threads = min(n, pool.started + 1);
+	n = pool.threads;
+	pthread_mutex_unlock(&pool.lock);
+
+	return n;
+}
+
+/**
+ * Band height for rows output rows of row_bytes each: up to two bands per
+ * thread, so one slow core doesn't hold up the frame, but no band under
+ * BAND_MIN_BYTES, and a multiple of align rows.
+ */
+static int band_height(int rows, int row_bytes, int align)
+{
+	int bands = pool.threads > 1 ? pool.threads * 2 : 1;
+	int height;
+
+	bands = min(bands, rows * row_bytes / BAND_MIN_BYTES);
+	if (bands < 1)
+		bands = 1;
+
+	height = (rows + bands - 1) / bands;
+	height = (height + align - 1) / align * align;
+
+	return max(height, 1);
+}
+
+static _X_INLINE int band_count(int rows, int height)
+{
+	return (rows + height - 1) / height;
+}
+
+static void run_bands(const struct band_job *j, int rows, int height)
+{
+	int y;
+
+	if (rows <= 0)
+		return;
+
+	if (height >= rows) {
+		j->rows(j, 0, 0, rows);
+		return;
+	}
+
+	/* Nested or concurrent use just runs the bands here. */
+	pthread_mutex_lock(&pool.lock);
+	if (pool.job || pool.threads == 1) {
+		pthread_mutex_unlock(&pool.lock);
+		for (y = 0; y < rows; y += height)
+			j->rows(j, y / height, y, min(y + height, rows));
+		return;
+	}
+
+	pool.job = j;
+	pool.rows = rows;
+	pool.height = height;
+	pool.next = 0;
+	pool.generation++;
+	pthread_cond_broadcast(&pool.work);
+
+	take_bands();
+	while (pool.active)
+		pthread_cond_wait(&pool.done, &pool.lock);
+
+	pool.job = NULL;
+	pthread_mutex_unlock(&pool.lock);
+}
+
+/* Where output row y0 of a scaled copy starts: source row, and the
+ * fraction into it. */
+static _X_INLINE void band_start(int y0, int inc, int *row, int *frac)
+{
+	long long pos = (long long)y0 * inc;
+
+	*row = pos >> 16;
+	*frac = pos & 0xffff;
+}
+
+/* Straight copies, either row by row or, when source and destination
+ * rows line up, the whole band at once. */
+static void copy_rows(const struct band_job *j, int band, int y0, int y1)
+{
+	const CARD8 *src = j->src + y0 * j->srcPitch;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+
+	if (j->contig) {
+		j->k->copy_row(dst, src, (y1 - y0) * j->srcPitch);
+		return;
+	}
+
+	for (; y0 < y1; y0++) {
+		j->k->copy_row(dst, src, j->w);
+		src += j->srcPitch;
+		dst += j->dstPitch;
+	}
+}
+
+/*
+ * Rotated copies.  The output is walked in square tiles small enough that
+ * the source lines a tile touches (one per output column when rotating by
+ * 90 or 270) and the tile itself stay in L1 together: 32x32 at 4 bytes per
+ * pixel is 8K of source plus 4K of output, inside the A8's 16K/32K L1.
+ * Each output line of a tile is still written as one linear burst.
+ */
+#define ROTATE_TILE 32
+
+enum rotate_kind {
+	ROTATE_16,
+	ROTATE_32,
+	ROTATE_PACKED,
+	ROTATE_PLANAR,
+};
+
+/* Byte offset of sample (x, y) in a plane is
+ * ((x >> x_shift) * x_mul + x_add) + (y >> y_shift) * y_mul. */
+struct rotate_plane {
+	int x_shift, x_mul, x_add;
+	int y_shift, y_mul;
+};
+
+struct rotate_map {
+	int out_w, out_h;
+	int *col[2];		/* Byte offset per output column, per plane. */
+	int *row[2];		/* Byte offset per output line, per plane. */
+};
+
+static int rotate_offset(const struct rotate_plane *p, Bool is_x, int i)
+{
+	if (is_x)
+		return (i >> p->x_shift) * p->x_mul + p->x_add;
+	else
+		return (i >> p->y_shift) * p->y_mul;
+}
+
+/**
+ * Work out which source sample lands on each output column and line.  The
+ * output is in scanout orientation: for 90 and 270 output columns walk
+ * source lines and output lines walk source columns.  Scaling, if any, is
+ * nearest neighbour.
+ */
+static Bool rotate_map_init(struct rotate_map *m, int randr,
+			    Bool hscale, Bool vscale, int srcW, int srcH,
+			    int left, int top, int dstW, int dstH, int align,
+			    const struct rotate_plane *planes, int nplanes)
+{
+	Bool swap = randr == RR_Rotate_90 || randr == RR_Rotate_270;
+	Bool flip_x = randr == RR_Rotate_180 || randr == RR_Rotate_270;
+	Bool flip_y = randr == RR_Rotate_90 || randr == RR_Rotate_180;
+	int in_w = swap ? srcH : srcW, in_h = swap ? srcW : srcH;
+	int i, p, c, inc;
+
+	m->out_w = (hscale ? dstW : in_w) & ~(align - 1);
+	m->out_h = vscale ? dstH : in_h;
+	if (m->out_w <= 0 || m->out_h <= 0)
+		return FALSE;
+
+	m->col[0] = malloc(2 * (m->out_w + m->out_h) * sizeof(int));
+	if (!m->col[0])
+		return FALSE;
+	m->col[1] = m->col[0] + m->out_w;
+	m->row[0] = m->col[1] + m->out_w;
+	m->row[1] = m->row[0] + m->out_h;
+
+	inc = (in_w << 16) / m->out_w;
+	for (i = 0; i < m->out_w; i++) {
+		c = (i * inc) >> 16;
+		if (flip_x)
+			c = in_w - 1 - c;
+		c += swap ? top : left;
+		for (p = 0; p < nplanes; p++)
+			m->col[p][i] = rotate_offset(&planes[p], !swap, c);
+	}
+
+	inc = (in_h << 16) / m->out_h;
+	for (i = 0; i < m->out_h; i++) {
+		c = (i * inc) >> 16;
+		if (flip_y)
+			c = in_h - 1 - c;
+		c += swap ? left : top;
+		for (p = 0; p < nplanes; p++)
+			m->row[p][i] = rotate_offset(&planes[p], swap, c);
+	}
+
+	return TRUE;
+}
+
+static void rotate_copy(enum rotate_kind kind, const struct rotate_map *m,
+			CARD8 * const *src, CARD8 * dst, int dstPitch, int lo)
+{
+	const int *col0 = m->col[0], *col1 = m->col[1];
+	int tx, ty, tw, th, x, y;
+
+	for (ty = 0; ty < m->out_h; ty += ROTATE_TILE) {
+		th = min(ROTATE_TILE, m->out_h - ty);
+
+		for (tx = 0; tx < m->out_w; tx += ROTATE_TILE) {
+			tw = min(ROTATE_TILE, m->out_w - tx);
+
+			for (y = ty; y < ty + th; y++) {
+				const CARD8 *s0 = src[0] + m->row[0][y];
+				CARD8 *d = dst + y * dstPitch;
+
+				switch (kind) {
+				case ROTATE_16: {
+					CARD16 *d16 = (CARD16 *) d + tx;
+
+					for (x = tx; x < tx + tw; x++)
+						*d16++ =
+						    *(const CARD16 *)(s0 + col0[x]);
+					break;
+				}
+				case ROTATE_32: {
+					CARD32 *d32 = (CARD32 *) d + tx;
+
+					for (x = tx; x < tx + tw; x++)
+						*d32++ =
+						    *(const CARD32 *)(s0 + col0[x]);
+					break;
+				}
+				case ROTATE_PACKED: {
+					const CARD8 *s1 = src[0] + m->row[1][y];
+					CARD32 *d32 = (CARD32 *) d + (tx >> 1);
+					CARD32 y0, y1, u, v;
+
+					for (x = tx; x < tx + tw; x += 2) {
+						y0 = s0[col0[x]];
+						y1 = s0[col0[x + 1]];
+						u = s1[col1[x]];
+						v = s1[col1[x] + 2];
+						if (lo)
+							*d32++ = u | (y0 << 8) |
+							    (v << 16) | (y1 << 24);
+						else
+							*d32++ = y0 | (u << 8) |
+							    (y1 << 16) | (v << 24);
+					}
+					break;
+				}
+				case ROTATE_PLANAR: {
+					const CARD8 *su = src[1] + m->row[1][y];
+					const CARD8 *sv = src[2] + m->row[1][y];
+					CARD32 *d32 = (CARD32 *) d + (tx >> 1);
+
+					for (x = tx; x < tx + tw; x += 2)
+						*d32++ = s0[col0[x]] |
+						    (su[col1[x]] << 8) |
+						    (s0[col0[x + 1]] << 16) |
+						    ((CARD32) sv[col1[x]] << 24);
+					break;
+				}
+				}
+			}
+		}
+	}
+}
+
+static void rotate_packed(int randr, Bool hscale, Bool vscale,
+			  CARD8 * src, CARD8 * dst, int srcPitch, int dstPitch,
+			  int srcW, int srcH, int left, int top, int dstW,
+			  int dstH, int lo)
+{
+	const struct rotate_plane planes[2] = {
+		{0, 2, lo, 0, srcPitch},
+		{1, 4, !lo, 0, srcPitch},
+	};
+	struct rotate_map m;
+
+	if (!rotate_map_init(&m, randr, hscale, vscale, srcW, srcH, left,
+			     top, dstW, dstH, 2, planes, 2)) {
+		ErrorF("omap_copy_packed: couldn't rotate\n");
+		return;
+	}
+
+	rotate_copy(ROTATE_PACKED, &m, &src, dst, dstPitch, lo);
+	free(m.col[0]);
+}
+
+static void rotate_planar(int randr, Bool hscale, Bool vscale,
+			  CARD8 * src, CARD8 * dst, int srcPitch,
+			  int srcPitch2, int dstPitch, int srcW, int srcH,
+			  int left, int top, int h, int id, int dstW, int dstH)
+{
+	const struct rotate_plane planes[2] = {
+		{0, 1, 0, 0, srcPitch},
+		{1, 1, 0, 1, srcPitch2},
+	};
+	struct rotate_map m;
+	CARD8 *planes_src[3];
+
+	planes_src[0] = src;
+	planes_src[1] = src + h * srcPitch;
+	planes_src[2] = planes_src[1] + (h >> 1) * srcPitch2;
+
+	if (id != FOURCC_I420) {
+		CARD8 *tmp = planes_src[1];
+		planes_src[1] = planes_src[2];
+		planes_src[2] = tmp;
+	}
+
+	if (!rotate_map_init(&m, randr, hscale, vscale, srcW, srcH, left,
+			     top, dstW, dstH, 2, planes, 2)) {
+		ErrorF("omap_copy_planar: couldn't rotate\n");
+		return;
+	}
+
+	rotate_copy(ROTATE_PLANAR, &m, planes_src, dst, dstPitch, 0);
+	free(m.col[0]);
+}
+
+static void rotate_rgb(int randr, Bool hscale, Bool vscale, int bpp,
+		       CARD8 * src, CARD8 * dst, int srcPitch, int dstPitch,
+		       int srcW, int srcH, int left, int top, int dstW,
+		       int dstH)
+{
+	const struct rotate_plane plane = { 0, bpp >> 3, 0, 0, srcPitch };
+	const struct omap_copy_kernels *k = get_kernels();
+	struct rotate_map m;
+
+	/* Unscaled quarter turns are plain transposes: written bottom up for
+	 * 90, read from the last source line up for 270. */
+	if (!hscale && !vscale &&
+	    (randr == RR_Rotate_90 || randr == RR_Rotate_270)) {
+		src += top * srcPitch + left * (bpp >> 3);
+		if (randr == RR_Rotate_90) {
+			dst += (srcW - 1) * dstPitch;
+			dstPitch = -dstPitch;
+		} else {
+			src += (srcH - 1) * srcPitch;
+			srcPitch = -srcPitch;
+		}
+
+		if (bpp == 32)
+			k->transpose_32(dst, dstPitch, src, srcPitch, srcW, srcH);
+		else
+			k->transpose_16(dst, dstPitch, src, srcPitch, srcW, srcH);
+		return;
+	}
+
+	if (!rotate_map_init(&m, randr, hscale, vscale, srcW, srcH, left,
+			     top, dstW, dstH, 1, &plane, 1)) {
+		ErrorF("omap_copy_%d: couldn't rotate\n", bpp);
+		return;
+	}
+
+	rotate_copy(bpp == 32 ? ROTATE_32 : ROTATE_16, &m, &src, dst,
+		    dstPitch, 0);
+	free(m.col[0]);
+}
+
+/*
+ * Source offsets.  The converters take the rectangle (left, top, srcW, srcH)
+ * out of a w x h image and write it to the top left of dst, so a caller
+ * can update part of a plane by offsetting dst.  Chroma is always looked
+ * up from absolute source coordinates.  An odd left offset puts every
+ * output macropixel across two source chroma samples, which are averaged,
+ * and an odd top offset simply starts on the second line of a chroma row.
+ */
+
+/* Average of chroma samples i and i + 1, for odd left offsets. */
+static _X_INLINE CARD8 chroma_mid(const CARD8 * c, int i)
+{
+	return (c[i] + c[i + 1] + 1) >> 1;
+}
+
+/* chroma_mid(), not reading past sample last at the end of a row. */
+static _X_INLINE CARD8 chroma_mid_to(const CARD8 * c, int i, int last)
+{
+	return (c[min(i, last)] + c[min(i + 1, last)] + 1) >> 1;
+}
+
+/**
+ * One line of YUY2/UYVY starting on the second pixel of a macropixel:
+ * each output macropixel takes the odd luma of one source macropixel and
+ * the even luma of the next, with their chroma averaged.
+ */
+static void packed_row_odd(CARD8 * dst, const CARD8 * src, int pairs, int lo)
+{
+	CARD32 *d = (CARD32 *) dst;
+	int co = !lo;
+	CARD32 y0, y1, u, v;
+
+	while (pairs--) {
+		y0 = src[lo + 2];
+		y1 = src[lo + 4];
+		u = (src[co] + src[co + 4] + 1) >> 1;
+		v = (src[co + 2] + src[co + 6] + 1) >> 1;
+		if (lo)
+			*d++ = u | (y0 << 8) | (v << 16) | (y1 << 24);
+		else
+			*d++ = y0 | (u << 8) | (y1 << 16) | (v << 24);
+		src += 4;
+	}
+}
+
+/**
+ * Point c1/c2 at the chroma for source line y (absolute) of a planar
+ * image, averaging into the scratch rows when left is odd.
+ */
+static void planar_chroma_row(const CARD8 ** c1, const CARD8 ** c2,
+			      const CARD8 * u, const CARD8 * v, int pitch2,
+			      int y, int left, int pairs, CARD8 * scratch)
+{
+	const CARD8 *ru = u + (y >> 1) * pitch2 + (left >> 1);
+	const CARD8 *rv = v + (y >> 1) * pitch2 + (left >> 1);
+	int i;
+
+	if (!(left & 1)) {
+		*c1 = ru;
+		*c2 = rv;
+		return;
+	}
+
+	for (i = 0; i < pairs; i++) {
+		scratch[i] = chroma_mid(ru, i);
+		scratch[pairs + i] = chroma_mid(rv, i);
+	}
+	*c1 = scratch;
+	*c2 = scratch + pairs;
+}
+
+static void packed_odd_rows(const struct band_job *j, int band, int y0,
+			    int y1)
+{
+	const CARD8 *src = j->src + y0 * j->srcPitch;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+
+	for (; y0 < y1; y0++) {
+		packed_row_odd(dst, src, j->w, j->lo);
+		src += j->srcPitch;
+		dst += j->dstPitch;
+	}
+}
 
 /**
  * Copy YUV422/YUY2 data with no scaling.
@@ -43,18 +847,70 @@ void omap_copy_packed(CARD8 * src, CARD8 * dst,
 		      int srcPitch, int dstPitch,
 		      int srcW, int srcH,
 		      int left, int top,
-		      int w, int h)
+		      int w, int h,
+		      int id)
 {
-	src += top * srcPitch + (left << 1);
+	struct band_job j = { NULL };
+
+	if (randr != RR_Rotate_0) {
+		rotate_packed(randr, FALSE, FALSE, src, dst, srcPitch, dstPitch,
+			      srcW, srcH, left, top, 0, 0, id == FOURCC_UYVY);
+		return;
+	}
 
-	/* memcpy FTW on ARM. */
-	if (srcPitch == dstPitch && !left) {
-		memcpy(dst, src, srcH * srcPitch);
+	j.k = get_kernels();
+	j.srcPitch = srcPitch;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+
+	if (left & 1) {
+		j.rows = packed_odd_rows;
+		j.src = src + top * srcPitch + ((left & ~1) << 1);
+		j.w = srcW >> 1;
+		j.lo = id == FOURCC_UYVY;
 	} else {
-		while (srcH--) {
-			memcpy(dst, src, srcW << 1);
-			src += srcPitch;
-			dst += dstPitch;
+		j.rows = copy_rows;
+		j.src = src + top * srcPitch + (left << 1);
+		j.w = srcW << 1;
+		j.contig = srcPitch == dstPitch && !left;
+	}
+
+	run_bands(&j, srcH, band_height(srcH, srcW << 1, 1));
+}
+
+static void scale_packed_rows(const struct band_job *j, int band, int y0,
+			      int y1)
+{
+	const CARD8 *src;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+	int x, row, srcx, srcy;
+
+	band_start(y0, j->yinc, &row, &srcy);
+	src = j->src + row * j->srcPitch;
+
+	for (; y0 < y1; y0++) {
+		if (!j->hscale) {
+			if (j->left & 1)
+				packed_row_odd(dst, src, j->w, j->lo);
+			else
+				j->k->copy_row(dst, src, j->w << 2);
+		} else {
+			const CARD32 *s = (const CARD32 *) src;
+			CARD32 *d = (CARD32 *) dst;
+
+			srcx = 0;
+			for (x = 0; x < j->w; x++) {
+				*d++ = s[srcx >> 17];
+				srcx += j->xinc << 1;
+			}
+		}
+
+		dst += j->dstPitch;
+
+		srcy += j->yinc;
+		while (srcy > 0xffff) {
+			src += j->srcPitch;
+			srcy -= 0x10000;
 		}
 	}
 }
@@ -72,19 +928,15 @@ void omap_copy_scale_packed(Bool hscale, Bool vscale,
 			    int srcW, int srcH,
 			    int left, int top,
 			    int w, int h,
+			    int id,
 			    int dstW, int dstH)
 {
-	int x, y, srcx, srcy;
-	int xinc = hscale ? (srcW << 16) / dstW : 0x10000;
-	int yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+	struct band_job j = { NULL };
 
 	if (randr != RR_Rotate_0) {
-		ErrorF("omapCopyPackedData: rotation not supported\n");
-		return;
-	}
-
-	if (top || left) {
-		ErrorF("omapCopyPackedData: partial updates not supported\n");
+		rotate_packed(randr, hscale, vscale, src, dst, srcPitch,
+			      dstPitch, srcW, srcH, left, top, dstW, dstH,
+			      id == FOURCC_UYVY);
 		return;
 	}
 
@@ -95,35 +947,38 @@ void omap_copy_scale_packed(Bool hscale, Bool vscale,
 		dstW &= ~1;
 	}
 
-	w >>= 1;
-
-	if (hscale)
-		w = w * dstW / srcW;
-	if (vscale)
-		h = h * dstH / srcH;
-
-	srcy = 0;
-	for (y = 0; y < h; y++) {
-		if (!hscale) {
-			memcpy(dst, src, w << 2);
-		} else {
-			CARD32 *s = (CARD32 *) src;
-			CARD32 *d = (CARD32 *) dst;
-
-			srcx = 0;
-			for (x = 0; x < w; x++) {
-				*d++ = s[srcx >> 17];
-				srcx += xinc << 1;
-			}
-		}
-
-		dst += dstPitch;
+	/* Whole macropixels are dropped or repeated anyway, so an odd left
+	 * offset just starts on the macropixel it falls in. */
+	j.rows = scale_packed_rows;
+	j.k = get_kernels();
+	j.src = src + top * srcPitch + ((left & ~1) << 1);
+	j.srcPitch = srcPitch;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = (hscale ? dstW : srcW) >> 1;
+	j.left = left;
+	j.xinc = hscale ? (srcW << 16) / dstW : 0x10000;
+	j.yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+	j.lo = id == FOURCC_UYVY;
+	j.hscale = hscale;
+
+	h = vscale ? dstH : srcH;
+	run_bands(&j, h, band_height(h, j.w << 2, 1));
+}
 
-		srcy += yinc;
-		while (srcy > 0xffff) {
-			src += srcPitch;
-			srcy -= 0x10000;
-		}
+static void planar_rows(const struct band_job *j, int band, int y0, int y1)
+{
+	CARD8 scratch[VIDEO_IMAGE_MAX_WIDTH];
+	const CARD8 *src = j->src + y0 * j->srcPitch;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+	const CARD8 *c1, *c2;
+
+	for (; y0 < y1; y0++) {
+		planar_chroma_row(&c1, &c2, j->c1, j->c2, j->srcPitch2,
+				  j->top + y0, j->left, j->w, scratch);
+		j->k->planar_row(dst, src, c1, c2, j->w);
+		src += j->srcPitch;
+		dst += j->dstPitch;
 	}
 }
 
@@ -138,17 +993,22 @@ void omap_copy_planar(CARD8 * src, CARD8 * dst,
 		      int w, int h,
 		      int id)
 {
-	int i, j;
-	CARD8 *src1, *src2, *src3, *dst1;
+	struct band_job j = { NULL };
+	CARD8 *src1, *src2, *src3;
+
+	if (randr != RR_Rotate_0) {
+		rotate_planar(randr, FALSE, FALSE, src, dst, srcPitch,
+			      srcPitch2, dstPitch, srcW, srcH, left, top, h,
+			      id, 0, 0);
+		return;
+	}
 
 	/* compute source data pointers */
 	src1 = src;
 	src2 = src1 + h * srcPitch;
 	src3 = src2 + (h >> 1) * srcPitch2;
 
-	src += top * srcPitch + left;
-	src2 += (top >> 1) * srcPitch2 + (left >> 1);
-	src3 += (top >> 1) * srcPitch2 + (left >> 1);
+	src1 += top * srcPitch + left;
 
 	if (id == FOURCC_I420) {
 		CARD8 *srct = src3;
@@ -156,29 +1016,54 @@ void omap_copy_planar(CARD8 * src, CARD8 * dst,
 		src2 = srct;
 	}
 
-	dst1 = dst;
+	j.rows = planar_rows;
+	j.k = get_kernels();
+	j.src = src1;
+	j.c1 = src3;
+	j.c2 = src2;
+	j.srcPitch = srcPitch;
+	j.srcPitch2 = srcPitch2;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = srcW >> 1;
+	j.left = left;
+	j.top = top;
+
+	run_bands(&j, srcH, band_height(srcH, srcW << 1, 2));
+}
 
-	srcW >>= 1;
-	for (j = 0; j < srcH; j++) {
-		CARD32 *dst = (CARD32 *) dst1;
-		CARD16 *s1 = (CARD16 *) src1;
-		CARD8 *s2 = src2;
-		CARD8 *s3 = src3;
+static void scale_planar_rows(const struct band_job *j, int band, int y0,
+			      int y1)
+{
+	CARD8 *dstb = j->dst + y0 * j->dstPitch;
+	const CARD8 *s1, *s2, *s3;
+	int x, row, srcx, srcy, sx, sy;
+	int left = j->left, xinc = j->xinc;
+
+	/* Source coordinates are absolute, so chroma stays in phase with
+	 * luma whatever the offset. */
+	band_start(y0, j->yinc, &row, &srcy);
+	for (; y0 < y1; y0++) {
+		CARD32 *d = (CARD32 *) dstb;
 
-		for (i = 0; i < srcW; i++) {
-			*dst++ =
-			    (*s1 & 0x00ff) | ((*s1 & 0xff00) << 8) | (*s3 << 8)
-			    | (*s2 << 24);
-			s1++;
-			s2++;
-			s3++;
-		}
-		src1 += srcPitch;
-		dst1 += dstPitch;
-		if (j & 1) {
-			src2 += srcPitch2;
-			src3 += srcPitch2;
+		sy = j->top + row;
+		s1 = j->src + sy * j->srcPitch;
+		s2 = j->c2 + (sy >> 1) * j->srcPitch2;
+		s3 = j->c1 + (sy >> 1) * j->srcPitch2;
+
+		srcx = 0;
+		for (x = 0; x < j->w; x++) {
+			sx = left + (srcx >> 16);
+
+			*d++ = s1[sx] | (s1[left + ((srcx + xinc) >> 16)] << 16)
+			    | (s3[sx >> 1] << 8) | ((CARD32) s2[sx >> 1] << 24);
+			srcx += xinc << 1;
 		}
+
+		dstb += j->dstPitch;
+		srcy += j->yinc;
+		row += srcy >> 16;
+		srcy &= 0xffff;
 	}
 }
 
@@ -198,17 +1083,13 @@ void omap_copy_scale_planar(Bool hscale, Bool vscale,
 			    int id,
 			    int dstW, int dstH)
 {
-	CARD8 *src1, *src2, *src3, *dst1;
-	int x, y, srcx, srcy1, srcy2;
-	int xinc = hscale ? (srcW << 16) / dstW : 0x10000;
-	int yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+	struct band_job j = { NULL };
+	CARD8 *src1, *src2, *src3;
 
 	if (randr != RR_Rotate_0) {
-		ErrorF("omapExpandPlanarData: rotation not supported\n");
-		return;
-	}
-	if (top || left) {
-		ErrorF("omapExpandPlanarData: partial updates not supported\n");
+		rotate_planar(randr, hscale, vscale, src, dstb, srcPitch,
+			      srcPitch2, dstPitch, srcW, srcH, left, top, h,
+			      id, dstW, dstH);
 		return;
 	}
 
@@ -223,44 +1104,489 @@ void omap_copy_scale_planar(Bool hscale, Bool vscale,
 		src3 = tmp;
 	}
 
-	dst1 = dstb;
+	j.rows = scale_planar_rows;
+	j.src = src1;
+	j.c1 = src3;
+	j.c2 = src2;
+	j.srcPitch = srcPitch;
+	j.srcPitch2 = srcPitch2;
+	j.dst = dstb;
+	j.dstPitch = dstPitch;
+	j.w = (hscale ? dstW : srcW) >> 1;
+	j.left = left;
+	j.top = top;
+	j.xinc = hscale ? (srcW << 16) / dstW : 0x10000;
+	j.yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+
+	h = vscale ? dstH : srcH;
+	run_bands(&j, h, band_height(h, j.w << 2, 2));
+}
 
-	w >>= 1;
+/*
+ * Filtered downscaling.  Each output row is produced in two passes: the
+ * source rows under it are combined vertically into a cached row buffer,
+ * then that row is resampled horizontally.  Source rows are walked strictly
+ * top to bottom and every output row is written once, in full, with the
+ * copy_row kernel, so the uncached plane only ever sees linear bursts.
+ *
+ * All weights are 8 bit fixed point; box averages multiply by a 16 bit
+ * reciprocal of the tap count instead of dividing.
+ */
 
-	if (hscale)
-		w = w * dstW / srcW;
-	if (vscale)
-		h = h * dstH / srcH;
+/* Sampling positions along one axis, shared by every row or column. */
+struct filter_map {
+	int *idx;		/* First source sample. */
+	int *wt;		/* Bilinear: weight of idx + 1.  Box: taps. */
+	int *recip;		/* Box: 65536 / taps, rounded. */
+};
 
-	srcy1 = 0;
-	srcy2 = 0;
-	for (y = 0; y < h; y++) {
-		CARD32 *d = (CARD32 *) dstb;
+static void filter_map_free(struct filter_map *m)
+{
+	free(m->idx);
+	m->idx = NULL;
+}
 
-		srcx = 0;
-		for (x = 0; x < w; x++) {
-			CARD8 s1l = src1[(srcx) >> 16];
-			CARD8 s1r = src1[(srcx + xinc) >> 16];
-			CARD8 s2 = src2[(srcx) >> 17];
-			CARD8 s3 = src3[(srcx) >> 17];
+/**
+ * Map dst_n outputs onto the half2 / 2 samples starting half-sample off2
+ * into the first avail ones.  Chroma counts in halves to cover exactly the
+ * luma it's subsampled from, whatever the parity of the offset; starting
+ * mid-sample, box taps take in the samples either side.
+ */
+static Bool filter_map_span(struct filter_map *m, int filter, int avail,
+			    int dst_n, int off2, int half2)
+{
+	int i, inc, pos, start, end, round;
+
+	m->idx = malloc(3 * dst_n * sizeof(int));
+	if (!m->idx)
+		return FALSE;
+	m->wt = m->idx + dst_n;
+	m->recip = m->wt + dst_n;
+
+	inc = (half2 << 15) / dst_n;
+	round = (off2 & 1) ? 2 * dst_n - 1 : 0;
+	for (i = 0; i < dst_n; i++) {
+		if (filter == OMAP_SCALE_BILINEAR) {
+			/* Sample at the centre of the output pixel. */
+			pos = (off2 << 15) + i * inc + (inc >> 1) - 0x8000;
+			if (pos < 0)
+				pos = 0;
+			m->idx[i] = pos >> 16;
+			m->wt[i] = (pos >> 8) & 0xff;
+			if (m->idx[i] >= avail - 1) {
+				m->idx[i] = avail - 1;
+				m->wt[i] = 0;
+			}
+		} else {
+			start = (off2 * dst_n + i * half2) / (2 * dst_n);
+			end = (off2 * dst_n + (i + 1) * half2 + round) /
+			    (2 * dst_n);
+			end = min(end, avail);
+			start = min(start, avail - 1);
+			if (end <= start)
+				end = start + 1;
+			m->idx[i] = start;
+			m->wt[i] = end - start;
+			m->recip[i] = (0x10000 + (m->wt[i] >> 1)) / m->wt[i];
+		}
+	}
 
-			*d++ = s1l | (s1r << 16) | (s3 << 8) | (s2 << 24);
-			srcx += xinc << 1;
+	return TRUE;
+}
+
+static Bool filter_map_init(struct filter_map *m, int filter, int src_n,
+			    int dst_n)
+{
+	return filter_map_span(m, filter, src_n, dst_n, 0, src_n << 1);
+}
+
+/**
+ * Resample one channel of a row, stepping src_step/dst_step bytes between
+ * samples so packed layouts can be filtered in place.
+ */
+static void filter_h(CARD8 * dst, int dst_step, const CARD8 * src,
+		     int src_step, const struct filter_map *m, int filter,
+		     int n)
+{
+	const CARD8 *s;
+	int i, j, f, sum;
+
+	if (filter == OMAP_SCALE_BILINEAR) {
+		for (i = 0; i < n; i++, dst += dst_step) {
+			s = src + m->idx[i] * src_step;
+			f = m->wt[i];
+			if (f)
+				*dst = (s[0] * (256 - f) + s[src_step] * f +
+					128) >> 8;
+			else
+				*dst = s[0];
 		}
+	} else {
+		for (i = 0; i < n; i++, dst += dst_step) {
+			s = src + m->idx[i] * src_step;
+			for (j = 0, sum = 0; j < m->wt[i]; j++, s += src_step)
+				sum += *s;
+			*dst = (sum * m->recip[i] + 0x8000) >> 16;
+		}
+	}
+}
+
+/**
+ * Combine the source rows under output row i into tmp, returning either
+ * tmp or, when a single source row covers it, that row itself.
+ */
+static const CARD8 *filter_v(CARD8 * tmp, CARD32 * acc, const CARD8 * src,
+			     int pitch, const struct filter_map *m,
+			     int filter, int i, int bytes)
+{
+	const CARD8 *s = src + m->idx[i] * pitch;
+	int j, k;
+
+	if (filter == OMAP_SCALE_BILINEAR) {
+		if (!m->wt[i])
+			return s;
+		get_kernels()->blend_row(tmp, s, s + pitch, m->wt[i], bytes);
+		return tmp;
+	}
+
+	if (m->wt[i] == 1)
+		return s;
+
+	for (k = 0; k < bytes; k++)
+		acc[k] = s[k];
+	for (j = 1; j < m->wt[i]; j++) {
+		s += pitch;
+		for (k = 0; k < bytes; k++)
+			acc[k] += s[k];
+	}
+	for (k = 0; k < bytes; k++)
+		tmp[k] = (acc[k] * m->recip[i] + 0x8000) >> 16;
+
+	return tmp;
+}
 
-		dstb += dstPitch;
+static void filter_packed_rows(const struct band_job *j, int band, int y0,
+			       int y1)
+{
+	int bytes = j->srcW << 1, co = !j->lo;
+	CARD8 *tmp = j->tmp + band * j->tmp_size, *out = tmp + bytes;
+	CARD32 *acc = j->acc + band * j->acc_size;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+	const CARD8 *row;
+
+	for (; y0 < y1; y0++) {
+		row = j->vscale ?
+		    filter_v(tmp, acc, j->src, j->srcPitch, j->vy, j->filter,
+			     y0, bytes) :
+		    j->src + y0 * j->srcPitch;
+
+		if (j->hscale) {
+			filter_h(out + j->lo, 2, row + j->lo, 2, j->hy,
+				 j->filter, j->w);
+			filter_h(out + co, 4, row + co, 4, j->hc, j->filter,
+				 j->w >> 1);
+			filter_h(out + co + 2, 4, row + co + 2, 4, j->hc,
+				 j->filter, j->w >> 1);
+			row = out;
+		}
+
+		j->k->copy_row(dst, row, j->w << 1);
+		dst += j->dstPitch;
+	}
+}
+
+/**
+ * Filtered version of omap_copy_scale_packed.  Luma and each chroma
+ * channel are filtered separately, so UV never bleeds into Y.
+ */
+void omap_copy_filter_packed(int filter, Bool hscale, Bool vscale,
+			     CARD8 * src, CARD8 * dst,
+			     int randr,
+			     int srcPitch, int dstPitch,
+			     int srcW, int srcH,
+			     int left, int top,
+			     int w, int h,
+			     int id,
+			     int dstW, int dstH)
+{
+	struct band_job j = { NULL };
+	struct filter_map hy = { NULL }, hc = { NULL }, v = { NULL };
+	int outW, outH, bytes, height, bands;
+
+	if (filter == OMAP_SCALE_NEAREST || randr != RR_Rotate_0)
+		goto nearest;
+
+	srcW &= ~1;
+	outW = (hscale ? dstW : srcW) & ~1;
+	outH = vscale ? dstH : srcH;
+	if (srcW < 2 || outW < 2 || outH < 1)
+		return;
+
+	bytes = srcW << 1;
+	height = band_height(outH, outW << 1, 1);
+	bands = band_count(outH, height);
+
+	/* Each band gets its own row buffers. */
+	j.tmp_size = bytes + (outW << 1);
+	j.acc_size = bytes;
+	j.tmp = malloc(bands * j.tmp_size);
+	j.acc = malloc(bands * j.acc_size * sizeof(CARD32));
+	if (!j.tmp || !j.acc || !filter_map_init(&v, filter, srcH, outH))
+		goto fail;
+	if (hscale && (!filter_map_init(&hy, filter, srcW, outW) ||
+		       !filter_map_init(&hc, filter, srcW >> 1, outW >> 1)))
+		goto fail;
+
+	j.rows = filter_packed_rows;
+	j.k = get_kernels();
+	j.src = src + top * srcPitch + ((left & ~1) << 1);
+	j.srcPitch = srcPitch;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = outW;
+	j.lo = id == FOURCC_UYVY;
+	j.hscale = hscale;
+	j.vscale = vscale;
+	j.filter = filter;
+	j.srcW = srcW;
+	j.hy = &hy;
+	j.hc = &hc;
+	j.vy = &v;
+
+	run_bands(&j, outH, height);
+
+	filter_map_free(&hc);
+	filter_map_free(&hy);
+	filter_map_free(&v);
+	free(j.acc);
+	free(j.tmp);
+	return;
+
+fail:
+	ErrorF("omap_copy_filter_packed: out of memory, not filtering\n");
+	filter_map_free(&hc);
+	filter_map_free(&hy);
+	filter_map_free(&v);
+	free(j.acc);
+	free(j.tmp);
+nearest:
+	omap_copy_scale_packed(hscale, vscale, src, dst, randr, srcPitch,
+			       dstPitch, srcW, srcH, left, top, w, h, id,
+			       dstW, dstH);
+}
 
-		srcy1 += yinc;
-		while (srcy1 > 0xffff) {
-			src1 += srcPitch;
-			srcy1 -= 0x10000;
+static void filter_planar_rows(const struct band_job *j, int band, int y0,
+			       int y1)
+{
+	int srcW = j->srcW, chromaW = j->chromaW;
+	CARD8 *tmp = j->tmp + band * j->tmp_size;
+	CARD8 *out = tmp + srcW + (chromaW << 1);
+	CARD32 *acc = j->acc + band * j->acc_size;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+	const CARD8 *ry, *r2, *r3;
+
+	for (; y0 < y1; y0++) {
+		if (j->vscale) {
+			ry = filter_v(tmp, acc, j->src, j->srcPitch, j->vy,
+				      j->filter, y0, srcW);
+			r2 = filter_v(tmp + srcW, acc, j->c2, j->srcPitch2,
+				      j->vc, j->filter, y0, chromaW);
+			r3 = filter_v(tmp + srcW + chromaW, acc, j->c1,
+				      j->srcPitch2, j->vc, j->filter, y0,
+				      chromaW);
+		} else {
+			ry = j->src + y0 * j->srcPitch;
+			r2 = j->c2 + ((y0 + (j->top & 1)) >> 1) * j->srcPitch2;
+			r3 = j->c1 + ((y0 + (j->top & 1)) >> 1) * j->srcPitch2;
 		}
-		srcy2 += yinc;
-		while (srcy2 > 0x1ffff) {
-			src2 += srcPitch2;
-			src3 += srcPitch2;
-			srcy2 -= 0x20000;
+
+		if (j->hscale) {
+			filter_h(out, 2, ry, 1, j->hy, j->filter, j->w);
+			filter_h(out + 1, 4, r3, 1, j->hc, j->filter,
+				 j->w >> 1);
+			filter_h(out + 3, 4, r2, 1, j->hc, j->filter,
+				 j->w >> 1);
+			j->k->copy_row(dst, out, j->w << 1);
+		} else {
+			j->k->planar_row(dst, ry, r3, r2, j->w >> 1);
 		}
+
+		dst += j->dstPitch;
+	}
+}
+
+/**
+ * Filtered version of omap_copy_scale_planar.  Chroma is resampled from
+ * its own half-height planes to every output line, from exactly the area
+ * under the luma: with an odd left or top that starts half a chroma sample
+ * in.  An odd left is resampled horizontally even when unscaled, which
+ * averages neighbouring chroma columns; an unscaled odd top takes each
+ * line's chroma row from its absolute source line, as the nearest path
+ * does.
+ */
+void omap_copy_filter_planar(int filter, Bool hscale, Bool vscale,
+			     CARD8 * src, CARD8 * dst,
+			     int randr,
+			     int srcPitch, int srcPitch2, int dstPitch,
+			     int srcW, int srcH,
+			     int left, int top,
+			     int w, int h,
+			     int id,
+			     int dstW, int dstH)
+{
+	struct band_job j = { NULL };
+	struct filter_map hy = { NULL }, hc = { NULL };
+	struct filter_map vy = { NULL }, vc = { NULL };
+	CARD8 *src1, *src2, *src3;
+	int outW, outH, chromaW, chromaH, height, bands;
+	Bool hfilter = hscale || (left & 1);
+
+	if (filter == OMAP_SCALE_NEAREST || randr != RR_Rotate_0)
+		goto nearest;
+
+	srcW &= ~1;
+	outW = (hscale ? dstW : srcW) & ~1;
+	outH = vscale ? dstH : srcH;
+	/* Chroma samples under the luma, but none past the planes. */
+	chromaW = min(((left + srcW + 1) >> 1), (w + 1) >> 1) - (left >> 1);
+	chromaH = min(((top + srcH + 1) >> 1), (h + 1) >> 1) - (top >> 1);
+	if (srcW < 2 || outW < 2 || outH < 1 || chromaW < 1 || chromaH < 1)
+		return;
+
+	/* compute source data pointers */
+	src1 = src;
+	src2 = src1 + h * srcPitch;
+	src3 = src2 + (h >> 1) * srcPitch2;
+
+	if (id == FOURCC_I420) {
+		CARD8 *t = src2;
+		src2 = src3;
+		src3 = t;
+	}
+
+	src1 += top * srcPitch + left;
+	src2 += (top >> 1) * srcPitch2 + (left >> 1);
+	src3 += (top >> 1) * srcPitch2 + (left >> 1);
+
+	height = band_height(outH, outW << 1, 2);
+	bands = band_count(outH, height);
+
+	/* Per band: luma row, both chroma rows, then the packed output
+	 * row. */
+	j.tmp_size = srcW + (chromaW << 1) + (outW << 1);
+	j.acc_size = max(srcW, chromaW);
+	j.tmp = malloc(bands * j.tmp_size);
+	j.acc = malloc(bands * j.acc_size * sizeof(CARD32));
+	if (!j.tmp || !j.acc || !filter_map_init(&vy, filter, srcH, outH) ||
+	    !filter_map_span(&vc, filter, chromaH, outH, top & 1, srcH))
+		goto fail;
+	if (hfilter && (!filter_map_init(&hy, filter, srcW, outW) ||
+			!filter_map_span(&hc, filter, chromaW, outW >> 1,
+					 left & 1, srcW)))
+		goto fail;
+
+	j.rows = filter_planar_rows;
+	j.k = get_kernels();
+	j.src = src1;
+	j.c1 = src3;
+	j.c2 = src2;
+	j.srcPitch = srcPitch;
+	j.srcPitch2 = srcPitch2;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = outW;
+	j.top = top;
+	j.hscale = hfilter;
+	j.vscale = vscale;
+	j.filter = filter;
+	j.srcW = srcW;
+	j.chromaW = chromaW;
+	j.hy = &hy;
+	j.hc = &hc;
+	j.vy = &vy;
+	j.vc = &vc;
+
+	run_bands(&j, outH, height);
+
+	filter_map_free(&hc);
+	filter_map_free(&hy);
+	filter_map_free(&vc);
+	filter_map_free(&vy);
+	free(j.acc);
+	free(j.tmp);
+	return;
+
+fail:
+	ErrorF("omap_copy_filter_planar: out of memory, not filtering\n");
+	filter_map_free(&hc);
+	filter_map_free(&hy);
+	filter_map_free(&vc);
+	filter_map_free(&vy);
+	free(j.acc);
+	free(j.tmp);
+nearest:
+	omap_copy_scale_planar(hscale, vscale, src, dst, randr, srcPitch,
+			       srcPitch2, dstPitch, srcW, srcH, left, top, w,
+			       h, id, dstW, dstH);
+}
+
+/**
+ * omap_copy_yuv420 for offsets that do not line up with its 4x2 blocks.
+ * Each output line pair takes its chroma from the source lines it covers,
+ * averaging two chroma rows when top is odd and two chroma columns when
+ * a block starts on an odd pixel.
+ */
+static void yuv420_offset(const CARD8 * srcy, const CARD8 * srcu,
+			  const CARD8 * srcv, CARD8 * dst, int srcPitch,
+			  int srcPitch2, int dstPitch, int srcW, int srcH,
+			  int left, int top, int w, int h)
+{
+	int last = (h - 1) >> 1, lastc = (w - 1) >> 1;
+	int i, j, x, c, r0, r1, c0, c1;
+	const CARD8 *sy, *p0, *p1;
+	CARD16 *d;
+
+	for (i = 0; i < srcH; i++) {
+		r0 = (top + (i & ~1)) >> 1;
+		r1 = min((top + (i | 1)) >> 1, last);
+		p0 = ((i & 1) ? srcv : srcu) + r0 * srcPitch2;
+		p1 = ((i & 1) ? srcv : srcu) + r1 * srcPitch2;
+		sy = srcy + (top + i) * srcPitch + left;
+		d = (CARD16 *) dst;
+
+		for (j = 0; j < srcW >> 2; j++, sy += 4) {
+			x = left + (j << 2);
+			c = x >> 1;
+			if (x & 1) {
+				c0 = (chroma_mid_to(p0, c, lastc) +
+				      chroma_mid_to(p1, c, lastc) + 1) >> 1;
+				c1 = (chroma_mid_to(p0, c + 1, lastc) +
+				      chroma_mid_to(p1, c + 1, lastc) + 1) >> 1;
+			} else {
+				c0 = (p0[c] + p1[c] + 1) >> 1;
+				c1 = (p0[min(c + 1, lastc)] +
+				      p1[min(c + 1, lastc)] + 1) >> 1;
+			}
+
+			*d++ = sy[0] | (c0 << 8);
+			*d++ = c1 | (sy[1] << 8);
+			*d++ = sy[3] | (sy[2] << 8);
+		}
+
+		dst += dstPitch;
+	}
+}
+
+static void yuv420_rows(const struct band_job *j, int band, int y0, int y1)
+{
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+
+	/* u on even lines, v on odd ones. */
+	for (; y0 < y1; y0++) {
+		j->k->yuv420_row(dst, j->src + y0 * j->srcPitch,
+				 ((y0 & 1) ? j->c2 : j->c1) +
+				 (y0 >> 1) * j->srcPitch2, j->w);
+		dst += j->dstPitch;
 	}
 }
 
@@ -285,21 +1611,14 @@ void omap_copy_yuv420(CARD8 * srcb, CARD8 * dstb,
 		      int w, int h,
 		      int id)
 {
+	struct band_job j = { NULL };
 	CARD8 *srcy, *srcu, *srcv, *dst;
-	CARD16 *d1;
-	CARD32 *d2;
-	int i, j;
 
 	if (randr != RR_Rotate_0) {
 		ErrorF("omapCopyPlanarData: rotation not supported\n");
 		return;
 	}
 
-	if (top || left || h != srcH || w != srcW) {
-		ErrorF("omapCopyPlanarData: offset updates not supported\n");
-		return;
-	}
-
 	srcy = srcb;
 	srcv = srcy + h * srcPitch;
 	srcu = srcv + (h >> 1) * srcPitch2;
@@ -311,45 +1630,54 @@ void omap_copy_yuv420(CARD8 * srcb, CARD8 * dstb,
 		srcu = tmp;
 	}
 
-	w >>= 2;
-	for (i = 0; i < h; i++) {
-		CARD32 *sy = (CARD32 *) srcy;
-		CARD16 *sc;
+	if ((left & 3) || (top & 1)) {
+		yuv420_offset(srcy, srcu, srcv, dst, srcPitch, srcPitch2,
+			      dstPitch, srcW, srcH, left, top, w, h);
+		return;
+	}
 
-		sc = (CARD16 *) ((i & 1) ? srcv : srcu);
-		d1 = (CARD16 *) dst;
+	j.rows = yuv420_rows;
+	j.k = get_kernels();
+	j.src = srcy + top * srcPitch + left;
+	j.c1 = srcu + (top >> 1) * srcPitch2 + (left >> 1);
+	j.c2 = srcv + (top >> 1) * srcPitch2 + (left >> 1);
+	j.srcPitch = srcPitch;
+	j.srcPitch2 = srcPitch2;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = srcW >> 2;
+
+	run_bands(&j, srcH, band_height(srcH, j.w * 6, 2));
+}
 
-		for (j = 0; j < w; j++) {
-			if (((unsigned long)d1) & 3) {
-				/* Luma 1, chroma 1. */
-				*d1++ =
-				    (*sy & 0x000000ff) | ((*sc & 0x00ff) << 8);
-				/* Chroma 2, luma 2. */
-				*d1++ =
-				    ((*sc & 0xff00) >> 8) | (*sy & 0x0000ff00);
-			} else {
-				d2 = (CARD32 *) d1;
-				/* Luma 1, chroma 1, chroma 2, luma 2. */
-				*d2++ =
-				    (*sy & 0x000000ff) | (*sc << 8) |
-				    ((*sy & 0x0000ff00) << 16);
-				d1 = (CARD16 *) d2;
-			}
-			/* Luma 4, luma 3. */
-			*d1++ =
-			    ((*sy & 0xff000000) >> 24) | ((*sy & 0x00ff0000) >>
-							  8);
-			sy++;
-			sc++;
-		}
+static void deinterleave_rows(const struct band_job *j, int band, int y0,
+			      int y1)
+{
+	for (; y0 < y1; y0++)
+		j->k->deinterleave_row(j->dst + y0 * j->dstPitch,
+				       j->dst2 + y0 * j->dstPitch,
+				       j->src + y0 * j->srcPitch, j->w);
+}
 
-		dst += dstPitch;
-		srcy += srcPitch;
-		if (i & 1) {
-			srcu += srcPitch2;
-			srcv += srcPitch2;
-		}
-	}
+/**
+ * Split interleaved chroma into two planes.
+ */
+void omap_copy_deinterleave(CARD8 * src, CARD8 * dst1, CARD8 * dst2,
+			    int srcPitch, int dstPitch,
+			    int w, int h)
+{
+	struct band_job j = { NULL };
+
+	j.rows = deinterleave_rows;
+	j.k = get_kernels();
+	j.src = src;
+	j.srcPitch = srcPitch;
+	j.dst = dst1;
+	j.dst2 = dst2;
+	j.dstPitch = dstPitch;
+	j.w = w;
+
+	run_bands(&j, h, band_height(h, w << 1, 1));
 }
 
 /**
@@ -362,60 +1690,42 @@ void omap_copy_16(CARD8 * src, CARD8 * dst,
 		  int left, int top,
 		  int w, int h)
 {
-	src += top * srcPitch + (left << 1);
-
-	/* memcpy FTW on ARM. */
-	if (srcPitch == dstPitch && !left) {
-		memcpy(dst, src, srcH * srcPitch);
-	} else {
-		while (srcH--) {
-			memcpy(dst, src, srcW << 1);
-			src += srcPitch;
-			dst += dstPitch;
-		}
-	}
-}
-
-/**
- * Copy 16 bit data with pixel replication/dropping scaling.
- */
-void omap_copy_scale_16(Bool hscale, Bool vscale,
-			CARD8 * src, CARD8 * dst,
-			int randr,
-			int srcPitch, int dstPitch,
-			int srcW, int srcH,
-			int left, int top,
-			int w, int h,
-			int dstW, int dstH)
-{
-	int srcx, srcy;
-	int xinc = hscale ? (srcW << 16) / dstW : 0x10000;
-	int yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+	struct band_job j = { NULL };
 
 	if (randr != RR_Rotate_0) {
-		ErrorF("omapCopyPackedData: rotation not supported\n");
+		rotate_rgb(randr, FALSE, FALSE, 16, src, dst, srcPitch,
+			   dstPitch, srcW, srcH, left, top, 0, 0);
 		return;
 	}
 
+	j.rows = copy_rows;
+	j.k = get_kernels();
+	j.src = src + top * srcPitch + (left << 1);
+	j.srcPitch = srcPitch;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = srcW << 1;
+	j.contig = srcPitch == dstPitch && !left;
 
-	if (top || left || h != srcH || w != srcW) {
-		ErrorF("omapCopyPlanarData: offset updates not supported\n");
-		return;
-	}
+	run_bands(&j, srcH, band_height(srcH, j.w, 1));
+}
+
+static void scale_16_rows(const struct band_job *j, int band, int y0, int y1)
+{
+	const CARD8 *src;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+	int row, srcx, srcy;
 
-	if (hscale)
-		w = w * dstW / srcW;
-	if (vscale)
-		h = h * dstH / srcH;
+	band_start(y0, j->yinc, &row, &srcy);
+	src = j->src + row * j->srcPitch;
 
-	srcy = 0;
-	while (h) {
-		if (!hscale) {
-			memcpy(dst, src, w << 1);
+	for (; y0 < y1; y0++) {
+		if (!j->hscale) {
+			j->k->copy_row(dst, src, j->w << 1);
 		} else {
-			CARD16 *s16 = (CARD16 *) src;
+			const CARD16 *s16 = (const CARD16 *) src;
 			CARD32 *d32 = (CARD32 *) dst;
-			int w2 = w;
+			int w2 = j->w;
 
 			srcx = 0;
 
@@ -423,14 +1733,15 @@ void omap_copy_scale_16(Bool hscale, Bool vscale,
 				CARD16 *d16 = (CARD16 *) d32;
 				*d16++ = s16[srcx >> 16];
 				d32 = (CARD32 *) d16;
-				srcx += xinc;
+				srcx += j->xinc;
 				w2--;
 			}
 
 			while (w2 > 1) {
 				*d32++ = s16[srcx >> 16] |
-					(s16[(srcx + xinc) >> 16] << 16);
-				srcx += xinc << 1;
+				    ((CARD32) s16[(srcx + j->xinc) >> 16] <<
+				     16);
+				srcx += j->xinc << 1;
 				w2 -= 2;
 			}
 
@@ -440,46 +1751,20 @@ void omap_copy_scale_16(Bool hscale, Bool vscale,
 			}
 		}
 
-		dst += dstPitch;
-		srcy += yinc;
+		dst += j->dstPitch;
+		srcy += j->yinc;
 
 		while (srcy > 0xffff) {
-			src += srcPitch;
+			src += j->srcPitch;
 			srcy -= 0x10000;
 		}
-
-		h--;
-	}
-}
-
-/**
- * Copy 32 bpp data with no scaling.
- */
-void omap_copy_32(CARD8 * src, CARD8 * dst,
-		  int randr,
-		  int srcPitch, int dstPitch,
-		  int srcW, int srcH,
-		  int left, int top,
-		  int w, int h)
-{
-	src += top * srcPitch + (left << 2);
-
-	/* memcpy FTW on ARM. */
-	if (srcPitch == dstPitch && !left) {
-		memcpy(dst, src, srcH * srcPitch);
-	} else {
-		while (srcH--) {
-			memcpy(dst, src, srcW << 2);
-			src += srcPitch;
-			dst += dstPitch;
-		}
 	}
 }
 
 /**
- * Copy 32 bit data with pixel replication/dropping scaling.
+ * Copy 16 bit data with pixel replication/dropping scaling.
  */
-void omap_copy_scale_32(Bool hscale, Bool vscale,
+void omap_copy_scale_16(Bool hscale, Bool vscale,
 			CARD8 * src, CARD8 * dst,
 			int randr,
 			int srcPitch, int dstPitch,
@@ -488,51 +1773,125 @@ void omap_copy_scale_32(Bool hscale, Bool vscale,
 			int w, int h,
 			int dstW, int dstH)
 {
-	int srcx, srcy;
-	int xinc = hscale ? (srcW << 16) / dstW : 0x10000;
-	int yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+	struct band_job j = { NULL };
 
 	if (randr != RR_Rotate_0) {
-		ErrorF("omapCopyPackedData: rotation not supported\n");
+		rotate_rgb(randr, hscale, vscale, 16, src, dst, srcPitch,
+			   dstPitch, srcW, srcH, left, top, dstW, dstH);
 		return;
 	}
 
+	j.rows = scale_16_rows;
+	j.k = get_kernels();
+	j.src = src + top * srcPitch + (left << 1);
+	j.srcPitch = srcPitch;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = hscale ? dstW : srcW;
+	j.xinc = hscale ? (srcW << 16) / dstW : 0x10000;
+	j.yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+	j.hscale = hscale;
+
+	h = vscale ? dstH : srcH;
+	run_bands(&j, h, band_height(h, j.w << 1, 1));
+}
+
+/**
+ * Copy 32 bpp data with no scaling.
+ */
+void omap_copy_32(CARD8 * src, CARD8 * dst,
+		  int randr,
+		  int srcPitch, int dstPitch,
+		  int srcW, int srcH,
+		  int left, int top,
+		  int w, int h)
+{
+	struct band_job j = { NULL };
 
-	if (top || left || h != srcH || w != srcW) {
-		ErrorF("omapCopyPlanarData: offset updates not supported\n");
+	if (randr != RR_Rotate_0) {
+		rotate_rgb(randr, FALSE, FALSE, 32, src, dst, srcPitch,
+			   dstPitch, srcW, srcH, left, top, 0, 0);
 		return;
 	}
 
-	if (hscale)
-		w = w * dstW / srcW;
-	if (vscale)
-		h = h * dstH / srcH;
+	j.rows = copy_rows;
+	j.k = get_kernels();
+	j.src = src + top * srcPitch + (left << 2);
+	j.srcPitch = srcPitch;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = srcW << 2;
+	j.contig = srcPitch == dstPitch && !left;
+
+	run_bands(&j, srcH, band_height(srcH, j.w, 1));
+}
+
+static void scale_32_rows(const struct band_job *j, int band, int y0, int y1)
+{
+	const CARD8 *src;
+	CARD8 *dst = j->dst + y0 * j->dstPitch;
+	int row, srcx, srcy;
+
+	band_start(y0, j->yinc, &row, &srcy);
+	src = j->src + row * j->srcPitch;
 
-	srcy = 0;
-	while (h) {
-		if (!hscale) {
-			memcpy(dst, src, w << 2);
+	for (; y0 < y1; y0++) {
+		if (!j->hscale) {
+			j->k->copy_row(dst, src, j->w << 2);
 		} else {
-			CARD32 *s32 = (CARD32 *) src;
+			const CARD32 *s32 = (const CARD32 *) src;
 			CARD32 *d32 = (CARD32 *) dst;
-			int w2 = w;
+			int w2 = j->w;
 
 			srcx = 0;
 			while (w2) {
 				*d32++ = s32[srcx >> 16];
-				srcx += xinc;
+				srcx += j->xinc;
 				w2--;
 			}
 		}
 
-		dst += dstPitch;
-		srcy += yinc;
+		dst += j->dstPitch;
+		srcy += j->yinc;
 
 		while (srcy > 0xffff) {
-			src += srcPitch;
+			src += j->srcPitch;
 			srcy -= 0x10000;
 		}
+	}
+}
+
+/**
+ * Copy 32 bit data with pixel replication/dropping scaling.
+ */
+void omap_copy_scale_32(Bool hscale, Bool vscale,
+			CARD8 * src, CARD8 * dst,
+			int randr,
+			int srcPitch, int dstPitch,
+			int srcW, int srcH,
+			int left, int top,
+			int w, int h,
+			int dstW, int dstH)
+{
+	struct band_job j = { NULL };
 
-		h--;
+	if (randr != RR_Rotate_0) {
+		rotate_rgb(randr, hscale, vscale, 32, src, dst, srcPitch,
+			   dstPitch, srcW, srcH, left, top, dstW, dstH);
+		return;
 	}
+
+	j.rows = scale_32_rows;
+	j.k = get_kernels();
+	j.src = src + top * srcPitch + (left << 2);
+	j.srcPitch = srcPitch;
+	j.dst = dst;
+	j.dstPitch = dstPitch;
+	j.w = hscale ? dstW : srcW;
+	j.xinc = hscale ? (srcW << 16) / dstW : 0x10000;
+	j.yinc = vscale ? (srcH << 16) / dstH : 0x10000;
+	j.hscale = hscale;
+
+	h = vscale ? dstH : srcH;
+	run_bands(&j, h, band_height(h, j.w << 2, 1));
 }
@@ -23,12 +23,44 @@
 #ifndef OMAP_VIDEO_FORMATS_H
 #define OMAP_VIDEO_FORMATS_H
 
+/**
+ * Pick the row kernels used by all converters: NULL for the fastest one
+ * the CPU supports, or "c"/"neon" to force one.  Returns FALSE if the
+ * requested kernels are not available.
+ */
+Bool omap_copy_select(const char *impl);
+
+/**
+ * Name of the row kernels in use.
+ */
+const char *omap_copy_impl(void);
+
+/**
+ * Convert unrotated frames in row bands across n threads, the caller
+ * included; at most four.  Returns the number actually in use.
+ */
+int omap_copy_threads(int n);
+
+/**
+ * Downscaling filters, fastest first.
+ */
+enum omap_scale_filter {
+	OMAP_SCALE_NEAREST,	/* Drop or repeat whole macropixels. */
+	OMAP_SCALE_BILINEAR,	/* Two taps in each direction. */
+	OMAP_SCALE_BOX,		/* Average every source pixel covered. */
+};
+
+/**
+ * Copy YUY2/UYVY data with no scaling.  id is only needed to rotate, as
+ * luma and chroma then have to be told apart.
+ */
 void omap_copy_packed(CARD8 * src, CARD8 * dst,
 		      int randr,
 		      int srcPitch, int dstPitch,
 		      int srcW, int srcH,
 		      int left, int top,
-		      int w, int h);
+		      int w, int h,
+		      int id);
 
 /**
  * Copy packed video data for downscaling, where 'scaling' in this case
@@ -43,8 +75,25 @@ void omap_copy_scale_packed(Bool hscale, Bool vscale,
 			    int srcW, int srcH,
 			    int left, int top,
 			    int w, int h,
+			    int id,
 			    int dstW, int dstH);
 
+/**
+ * As omap_copy_scale_packed, but resampling with the given filter; falls
+ * back to omap_copy_scale_packed for OMAP_SCALE_NEAREST and for rotated
+ * copies.  id tells YUY2 from UYVY, since luma and chroma are filtered
+ * separately.
+ */
+void omap_copy_filter_packed(int filter, Bool hscale, Bool vscale,
+			     CARD8 * src, CARD8 * dst,
+			     int randr,
+			     int srcPitch, int dstPitch,
+			     int srcW, int srcH,
+			     int left, int top,
+			     int w, int h,
+			     int id,
+			     int dstW, int dstH);
+
 /**
  * Copy I420/YV12 data to YUY2, with no scaling.  Originally from kxv.c.
  */
@@ -70,6 +119,19 @@ void omap_copy_scale_planar(Bool hscale, Bool vscale,
 			    int id,
 			    int dstW, int dstH);
 
+/**
+ * As omap_copy_scale_planar, but resampling with the given filter.
+ */
+void omap_copy_filter_planar(int filter, Bool hscale, Bool vscale,
+			     CARD8 * src, CARD8 * dst,
+			     int randr,
+			     int srcPitch, int srcPitch2, int dstPitch,
+			     int srcW, int srcH,
+			     int left, int top,
+			     int w, int h,
+			     int id,
+			     int dstW, int dstH);
+
 /**
  * Copy I420 data to the custom 'YUV420' format, which is actually:
  * y11 u11,u12,u21,u22 u13,u14,u23,u24 y12 y14 y13
@@ -89,6 +151,14 @@ void omap_copy_yuv420(CARD8 * srcb, CARD8 * dstb,
 		      int w, int h,
 		      int id);
 
+/**
+ * Split NV12/NV21 chroma into two planes, the first byte of each pair to
+ * dst1 and the second to dst2; w is in pairs.  For the SGX adaptor, which
+ * takes semi-planar video as I420 or YV12.
+ */
+void omap_copy_deinterleave(CARD8 * src, CARD8 * dst1, CARD8 * dst2,
+			    int srcPitch, int dstPitch,
+			    int w, int h);
 
 void omap_copy_16(CARD8 * src, CARD8 * dst,
 		  int randr,
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * NEON versions of the omap_copy_* row kernels.  The destination is
+ * normally uncached plane memory, so everything is written in full 64
+ * byte bursts that the write buffer can merge.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <arm_neon.h>
+
+#include "omap_video_types.h"
+#include "omap_video_kernels.h"
+
+static void copy_row_neon(CARD8 * dst, const CARD8 * src, int bytes)
+{
+	for (; bytes >= 64; bytes -= 64) {
+		uint8x16_t a = vld1q_u8(src);
+		uint8x16_t b = vld1q_u8(src + 16);
+		uint8x16_t c = vld1q_u8(src + 32);
+		uint8x16_t d = vld1q_u8(src + 48);
+
+		vst1q_u8(dst, a);
+		vst1q_u8(dst + 16, b);
+		vst1q_u8(dst + 32, c);
+		vst1q_u8(dst + 48, d);
+		src += 64;
+		dst += 64;
+	}
+
+	if (bytes)
+		memcpy(dst, src, bytes);
+}
+
+static void planar_row_neon(CARD8 * dst, const CARD8 * y, const CARD8 * c1,
+			    const CARD8 * c2, int pairs)
+{
+	for (; pairs >= 16; pairs -= 16) {
+		uint8x16x2_t luma = vld2q_u8(y);
+		uint8x16x4_t out;
+
+		out.val[0] = luma.val[0];
+		out.val[1] = vld1q_u8(c1);
+		out.val[2] = luma.val[1];
+		out.val[3] = vld1q_u8(c2);
+		vst4q_u8(dst, out);
+
+		y += 32;
+		c1 += 16;
+		c2 += 16;
+		dst += 64;
+	}
+
+	if (pairs)
+		omap_copy_kernels_c.planar_row(dst, y, c1, c2, pairs);
+}
+
+static void deinterleave_row_neon(CARD8 * d1, CARD8 * d2, const CARD8 * src,
+				  int pairs)
+{
+	for (; pairs >= 16; pairs -= 16) {
+		uint8x16x2_t uv = vld2q_u8(src);
+
+		vst1q_u8(d1, uv.val[0]);
+		vst1q_u8(d2, uv.val[1]);
+		src += 32;
+		d1 += 16;
+		d2 += 16;
+	}
+
+	if (pairs)
+		omap_copy_kernels_c.deinterleave_row(d1, d2, src, pairs);
+}
+
+static void blend_row_neon(CARD8 * dst, const CARD8 * a, const CARD8 * b,
+			   int f, int bytes)
+{
+	uint8x8_t fa = vdup_n_u8(256 - f);
+	uint8x8_t fb = vdup_n_u8(f);
+
+	for (; bytes >= 16; bytes -= 16) {
+		uint8x16_t va = vld1q_u8(a);
+		uint8x16_t vb = vld1q_u8(b);
+		uint16x8_t lo = vmull_u8(vget_low_u8(va), fa);
+		uint16x8_t hi = vmull_u8(vget_high_u8(va), fa);
+
+		lo = vmlal_u8(lo, vget_low_u8(vb), fb);
+		hi = vmlal_u8(hi, vget_high_u8(vb), fb);
+		vst1q_u8(dst, vcombine_u8(vrshrn_n_u16(lo, 8),
+					  vrshrn_n_u16(hi, 8)));
+
+		a += 16;
+		b += 16;
+		dst += 16;
+	}
+
+	if (bytes)
+		omap_copy_kernels_c.blend_row(dst, a, b, f, bytes);
+}
+
+static void yuv420_row_neon(CARD8 * dst, const CARD8 * y, const CARD8 * c,
+			    int blocks)
+{
+	for (; blocks >= 8; blocks -= 8) {
+		uint8x8x4_t luma = vld4_u8(y);
+		uint8x8x2_t chroma = vld2_u8(c);
+		uint8x8x2_t a = vzip_u8(luma.val[0], chroma.val[0]);
+		uint8x8x2_t b = vzip_u8(chroma.val[1], luma.val[1]);
+		uint8x8x2_t d = vzip_u8(luma.val[3], luma.val[2]);
+		uint16x8x3_t out;
+
+		/* Each block is three halfwords: y0 c0, c1 y1, y3 y2. */
+		out.val[0] = vreinterpretq_u16_u8(vcombine_u8(a.val[0],
+							      a.val[1]));
+		out.val[1] = vreinterpretq_u16_u8(vcombine_u8(b.val[0],
+							      b.val[1]));
+		out.val[2] = vreinterpretq_u16_u8(vcombine_u8(d.val[0],
+							      d.val[1]));
+		vst3q_u16((uint16_t *) dst, out);
+
+		y += 32;
+		c += 16;
+		dst += 48;
+	}
+
+	if (blocks)
+		omap_copy_kernels_c.yuv420_row(dst, y, c, blocks);
+}
+
+/*
+ * Transposes work in register tiles, 8x8 at 16 bpp and 4x4 at 32 bpp, a
+ * strip of destination lines at a time so each line is written in order.
+ * Whatever is left over at the right and bottom edges goes to C.
+ */
+static void transpose_16_neon(CARD8 * dst, int dstPitch, const CARD8 * src,
+			      int srcPitch, int w, int h)
+{
+	int x, y, i, w8 = w & ~7, h8 = h & ~7;
+
+	for (x = 0; x < w8; x += 8) {
+		for (y = 0; y < h8; y += 8) {
+			const CARD8 *s = src + y * srcPitch + x * 2;
+			CARD8 *d = dst + x * dstPitch + y * 2;
+			uint16x8_t r[8];
+			uint16x8x2_t t0, t1, t2, t3;
+			uint32x4x2_t u0, u1, u2, u3;
+
+			for (i = 0; i < 8; i++)
+				r[i] = vld1q_u16((const uint16_t *)
+						 (s + i * srcPitch));
+
+			/* Swap 16 bit, then 32 bit, then 64 bit pairs. */
+			t0 = vtrnq_u16(r[0], r[1]);
+			t1 = vtrnq_u16(r[2], r[3]);
+			t2 = vtrnq_u16(r[4], r[5]);
+			t3 = vtrnq_u16(r[6], r[7]);
+			u0 = vtrnq_u32(vreinterpretq_u32_u16(t0.val[0]),
+				       vreinterpretq_u32_u16(t1.val[0]));
+			u1 = vtrnq_u32(vreinterpretq_u32_u16(t0.val[1]),
+				       vreinterpretq_u32_u16(t1.val[1]));
+			u2 = vtrnq_u32(vreinterpretq_u32_u16(t2.val[0]),
+				       vreinterpretq_u32_u16(t3.val[0]));
+			u3 = vtrnq_u32(vreinterpretq_u32_u16(t2.val[1]),
+				       vreinterpretq_u32_u16(t3.val[1]));
+
+#define STORE_COL(n, lo, hi, part) \
+	vst1q_u16((uint16_t *)(d + (n) * dstPitch), vreinterpretq_u16_u32( \
+		vcombine_u32(vget_##part##_u32(lo), vget_##part##_u32(hi))))
+			STORE_COL(0, u0.val[0], u2.val[0], low);
+			STORE_COL(1, u1.val[0], u3.val[0], low);
+			STORE_COL(2, u0.val[1], u2.val[1], low);
+			STORE_COL(3, u1.val[1], u3.val[1], low);
+			STORE_COL(4, u0.val[0], u2.val[0], high);
+			STORE_COL(5, u1.val[0], u3.val[0], high);
+			STORE_COL(6, u0.val[1], u2.val[1], high);
+			STORE_COL(7, u1.val[1], u3.val[1], high);
+#undef STORE_COL
+		}
+
+		if (h8 < h)
+			omap_copy_kernels_c.transpose_16(dst + x * dstPitch +
+							 h8 * 2, dstPitch,
+							 src + h8 * srcPitch +
+							 x * 2, srcPitch, 8,
+							 h - h8);
+	}
+
+	if (w8 < w)
+		omap_copy_kernels_c.transpose_16(dst + w8 * dstPitch, dstPitch,
+						 src + w8 * 2, srcPitch,
+						 w - w8, h);
+}
+
+static void transpose_32_neon(CARD8 * dst, int dstPitch, const CARD8 * src,
+			      int srcPitch, int w, int h)
+{
+	int x, y, w4 = w & ~3, h4 = h & ~3;
+
+	for (x = 0; x < w4; x += 4) {
+		for (y = 0; y < h4; y += 4) {
+			const CARD8 *s = src + y * srcPitch + x * 4;
+			CARD8 *d = dst + x * dstPitch + y * 4;
+			uint32x4x2_t t0, t1;
+
+			t0 = vtrnq_u32(vld1q_u32((const uint32_t *)s),
+				       vld1q_u32((const uint32_t *)
+						 (s + srcPitch)));
+			t1 = vtrnq_u32(vld1q_u32((const uint32_t *)
+						 (s + 2 * srcPitch)),
+				       vld1q_u32((const uint32_t *)
+						 (s + 3 * srcPitch)));
+
+			vst1q_u32((uint32_t *)d,
+				  vcombine_u32(vget_low_u32(t0.val[0]),
+					       vget_low_u32(t1.val[0])));
+			vst1q_u32((uint32_t *)(d + dstPitch),
+				  vcombine_u32(vget_low_u32(t0.val[1]),
+					       vget_low_u32(t1.val[1])));
+			vst1q_u32((uint32_t *)(d + 2 * dstPitch),
+				  vcombine_u32(vget_high_u32(t0.val[0]),
+					       vget_high_u32(t1.val[0])));
+			vst1q_u32((uint32_t *)(d + 3 * dstPitch),
+				  vcombine_u32(vget_high_u32(t0.val[1]),
+					       vget_high_u32(t1.val[1])));
+		}
+
+		if (h4 < h)
+			omap_copy_kernels_c.transpose_32(dst + x * dstPitch +
+							 h4 * 4, dstPitch,
+							 src + h4 * srcPitch +
+							 x * 4, srcPitch, 4,
+							 h - h4);
+	}
+
+	if (w4 < w)
+		omap_copy_kernels_c.transpose_32(dst + w4 * dstPitch, dstPitch,
+						 src + w4 * 4, srcPitch,
+						 w - w4, h);
+}
+
+const struct omap_copy_kernels omap_copy_kernels_neon = {
+	.name = "neon",
+	.copy_row = copy_row_neon,
+	.planar_row = planar_row_neon,
+	.blend_row = blend_row_neon,
+	.yuv420_row = yuv420_row_neon,
+	.deinterleave_row = deinterleave_row_neon,
+	.transpose_16 = transpose_16_neon,
+	.transpose_32 = transpose_32_neon,
+};
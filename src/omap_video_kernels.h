@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OMAP_VIDEO_KERNELS_H
+#define OMAP_VIDEO_KERNELS_H
+
+/*
+ * Row kernels behind the omap_copy_* converters.  Every kernel has a plain
+ * C reference implementation; SIMD versions must produce identical bytes.
+ */
+struct omap_copy_kernels {
+	const char *name;
+
+	/* Copy bytes from src to dst. */
+	void (*copy_row) (CARD8 * dst, const CARD8 * src, int bytes);
+
+	/* Interleave pairs of lumas with one sample from each chroma plane
+	 * into y0 c1 y1 c2 macropixels. */
+	void (*planar_row) (CARD8 * dst, const CARD8 * y, const CARD8 * c1,
+			    const CARD8 * c2, int pairs);
+
+	/* Pack blocks of four lumas and two samples of one chroma plane
+	 * into the y0 c0 c1 y1 y3 y2 layout of OMAPFB_COLOR_YUV420. */
+	void (*yuv420_row) (CARD8 * dst, const CARD8 * y, const CARD8 * c,
+			    int blocks);
+
+	/* Split byte pairs between two planes: the first byte of each goes
+	 * to d1, the second to d2.  NV12/NV21 chroma. */
+	void (*deinterleave_row) (CARD8 * d1, CARD8 * d2, const CARD8 * src,
+				  int pairs);
+
+	/* dst = (a * (256 - f) + b * f + 128) >> 8, for 0 < f < 256. */
+	void (*blend_row) (CARD8 * dst, const CARD8 * a, const CARD8 * b,
+			   int f, int bytes);
+
+	/* Transpose a w x h block of 16 or 32 bit pixels: source column x
+	 * becomes destination line x.  Pitches are in bytes and may be
+	 * negative, which is how the 90 and 270 degree rotations are made. */
+	void (*transpose_16) (CARD8 * dst, int dstPitch, const CARD8 * src,
+			      int srcPitch, int w, int h);
+	void (*transpose_32) (CARD8 * dst, int dstPitch, const CARD8 * src,
+			      int srcPitch, int w, int h);
+};
+
+extern const struct omap_copy_kernels omap_copy_kernels_c;
+#ifdef HAVE_NEON
+extern const struct omap_copy_kernels omap_copy_kernels_neon;
+#endif
+
+#endif /* OMAP_VIDEO_KERNELS_H */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef OMAP_VIDEO_TYPES_H
+#define OMAP_VIDEO_TYPES_H
+
+/*
+ * The few server types the overlay converters use.  The driver gets them
+ * from the server headers; the standalone benchmark is built with
+ * OMAP_VIDEO_BENCH and gets minimal copies instead.
+ */
+
+#ifndef OMAP_VIDEO_BENCH
+
+#include "fbdev.h"
+#include "fourcc.h"
+
+#else
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+
+typedef uint8_t CARD8;
+typedef uint16_t CARD16;
+typedef uint32_t CARD32;
+typedef int Bool;
+
+#define TRUE 1
+#define FALSE 0
+
+#define _X_INLINE inline
+
+/* As in <X11/extensions/randr.h>. */
+#define RR_Rotate_0 1
+#define RR_Rotate_90 2
+#define RR_Rotate_180 4
+#define RR_Rotate_270 8
+
+/* As in the server's fourcc.h. */
+#define FOURCC_YUY2 0x32595559
+#define FOURCC_UYVY 0x59565955
+#define FOURCC_I420 0x30323449
+#define FOURCC_YV12 0x32315659
+
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof(a[0]))
+
+/* As in fbdev.h. */
+#define VIDEO_IMAGE_MAX_WIDTH 2048
+
+/* Provided by the benchmark. */
+void ErrorF(const char *f, ...);
+
+#ifdef DEBUG
+#define DebugF ErrorF
+#else
+#define DebugF(...)
+#endif
+
+#endif /* OMAP_VIDEO_BENCH */
+
+#endif /* OMAP_VIDEO_TYPES_H */
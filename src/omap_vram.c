@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+/*
+ * Overlay plane memory.  Each video plane holds one VRAM reservation,
+ * made with OMAPFB_SETUP_MEM on its own fd.  A reservation that is big
+ * enough is reused as it stands; one that isn't grows with some headroom,
+ * so a stream that creeps up in size doesn't reallocate every few frames.
+ * Free space is re-read from the kernel whenever a reservation changes,
+ * since only the kernel knows how fragmented VRAM is.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <linux/omapfb.h>
+
+#include "omap_procfs.h"
+#include "omap_vram.h"
+
+/* Growth headroom, as a fraction of the requested size. */
+#define VRAM_HEADROOM_SHIFT 2
+
+struct omap_vram {
+	int fd;				/* For OMAPFB_GET_VRAM_INFO. */
+	unsigned int largest_free;
+	struct {
+		int fd;			/* -1 if not ours. */
+		unsigned int size;
+	} plane[OMAP_VRAM_MAX_PLANES];
+};
+
+static unsigned int page_align(unsigned int size)
+{
+	unsigned int page = getpagesize();
+
+	return (size + page - 1) / page * page;
+}
+
+static void refresh(struct omap_vram *vram)
+{
+	struct omapfb_vram_info vram_info;
+
+	if (!ioctl(vram->fd, OMAPFB_GET_VRAM_INFO, &vram_info))
+		vram->largest_free = vram_info.largest_free_block;
+	else if (!(vram->largest_free = omap_vram_get_avail()))
+		ErrorF("omap/vram: couldn't get vram info\n");
+}
+
+static unsigned int query_size(int fd)
+{
+	struct omapfb_mem_info mem_info;
+
+	if (ioctl(fd, OMAPFB_QUERY_MEM, &mem_info) != 0)
+		return 0;
+
+	return mem_info.size;
+}
+
+static Bool setup_mem(int fd, unsigned int size)
+{
+	struct omapfb_mem_info mem_info;
+
+	/* Not everyone has (enough) SRAM, and allocating into SRAM usually
+	 * ends very badly anyway (kernel bugs), so we hardcode SDRAM here. */
+	mem_info.type = OMAPFB_MEMTYPE_SDRAM;
+	mem_info.size = size;
+
+	return ioctl(fd, OMAPFB_SETUP_MEM, &mem_info) == 0;
+}
+
+struct omap_vram *omap_vram_init(int fd)
+{
+	struct omap_vram *vram;
+	int i;
+
+	vram = xcalloc(1, sizeof(*vram));
+	if (!vram)
+		return NULL;
+
+	vram->fd = fd;
+	for (i = 0; i < OMAP_VRAM_MAX_PLANES; i++)
+		vram->plane[i].fd = -1;
+	refresh(vram);
+
+	return vram;
+}
+
+void omap_vram_fini(struct omap_vram *vram)
+{
+	xfree(vram);
+}
+
+Bool omap_vram_add_plane(struct omap_vram *vram, int plane, int fd)
+{
+	if (plane < 0 || plane >= OMAP_VRAM_MAX_PLANES)
+		return FALSE;
+
+	vram->plane[plane].fd = fd;
+	vram->plane[plane].size = query_size(fd);
+
+	/* Planes start with their memory fully allocated, so free it when
+	 * we take control. */
+	return omap_vram_release(vram, plane);
+}
+
+Bool omap_vram_fits(struct omap_vram *vram, int plane, unsigned int size)
+{
+	return size <= vram->plane[plane].size;
+}
+
+Bool omap_vram_reserve(struct omap_vram *vram, int plane, unsigned int size)
+{
+	int fd = vram->plane[plane].fd;
+	unsigned int grown;
+
+	if (omap_vram_fits(vram, plane, size))
+		return TRUE;
+
+	/* Ask for some headroom first, settling for the exact size. */
+	size = page_align(size);
+	grown = page_align(size + (size >> VRAM_HEADROOM_SHIFT));
+	if (!setup_mem(fd, grown))
+		(void)setup_mem(fd, size);
+
+	vram->plane[plane].size = query_size(fd);
+	refresh(vram);
+
+	DebugF("omap/vram: plane %d now holds %u bytes, largest free block "
+	       "%u\n", plane, vram->plane[plane].size, vram->largest_free);
+
+	return omap_vram_fits(vram, plane, size);
+}
+
+Bool omap_vram_release(struct omap_vram *vram, int plane)
+{
+	Bool ret;
+
+	ret = setup_mem(vram->plane[plane].fd, 0);
+	vram->plane[plane].size = query_size(vram->plane[plane].fd);
+	refresh(vram);
+
+	return ret;
+}
+
+unsigned int omap_vram_budget(struct omap_vram *vram)
+{
+	unsigned int share, budget = ~0U;
+	int i, unreserved = 0;
+
+	for (i = 0; i < OMAP_VRAM_MAX_PLANES; i++)
+		if (vram->plane[i].fd >= 0 && !vram->plane[i].size)
+			unreserved++;
+
+	/* Planes without memory share the largest free block; one that
+	 * already has more can always reuse its own.  The encoding is
+	 * the same for every port, so it's the least of these. */
+	share = vram->largest_free / max(unreserved, 1);
+	for (i = 0; i < OMAP_VRAM_MAX_PLANES; i++)
+		if (vram->plane[i].fd >= 0)
+			budget = min(budget, max(share, vram->plane[i].size));
+
+	return budget == ~0U ? share : budget;
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef OMAP_VRAM_H
+#define OMAP_VRAM_H
+
+#include "fbdev.h"
+
+#define OMAP_VRAM_MAX_PLANES 4
+
+struct omap_vram;
+
+/**
+ * Start tracking VRAM; fd is any omapfb device, used to query free
+ * space.
+ */
+struct omap_vram *omap_vram_init(int fd);
+void omap_vram_fini(struct omap_vram *vram);
+
+/**
+ * Take over a plane's memory, freeing whatever it was set up with.
+ */
+Bool omap_vram_add_plane(struct omap_vram *vram, int plane, int fd);
+
+/**
+ * Whether the plane already holds at least size bytes.
+ */
+Bool omap_vram_fits(struct omap_vram *vram, int plane, unsigned int size);
+
+/**
+ * Make the plane hold at least size bytes, reallocating with headroom if
+ * it doesn't yet.  The plane must not be mapped if it might reallocate.
+ */
+Bool omap_vram_reserve(struct omap_vram *vram, int plane, unsigned int size);
+Bool omap_vram_release(struct omap_vram *vram, int plane);
+
+/**
+ * Bytes any one plane can count on for its frames right now.
+ */
+unsigned int omap_vram_budget(struct omap_vram *vram);
+
+#endif
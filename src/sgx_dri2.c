@@ -30,6 +30,7 @@
 #include "dri2.h"
 
 #include "sgx_pvr2d.h"
+#include "omap_scanout.h"
 
 //#define DebugF	ErrorF
 
@@ -42,6 +43,10 @@ static Bool PVR2DDRI2MigratePixmap(struct PVR2DPixmap *ppix)
 	int shmsize;
 	void *mallocaddr;
 
+	/* The plane can't be shared by name. */
+	if (ppix->scanout && !omap_scanout_evict(ppix))
+		return FALSE;
+
 #if USE_MALLOC
 	if (ppix->mallocaddr) {
 		shmsize = ppix->shmsize;
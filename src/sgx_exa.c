@@ -26,6 +26,7 @@
 #if USE_SHM && defined(DRI2)
 #include "sgx_dri2.h"
 #endif
+#include "omap_scanout.h"
 
 #include "exa.h"
 #include "x-hash.h"
@@ -334,6 +335,44 @@ static void PVR2DDoneSolid(PixmapPtr pDstPixmap)
 {
 }
 
+/**
+ * Fill a region, in screen coordinates, of pDraw with fg through the solid
+ * fill path, so large areas go to the SGX.  Returns FALSE if the drawable
+ * can't be filled this way and the caller should fall back to fb.
+ */
+Bool PVR2DFillRegion(DrawablePtr pDraw, Pixel fg, RegionPtr region)
+{
+	PixmapPtr pPixmap =
+	    pDraw->type ==
+	    DRAWABLE_WINDOW ? pDraw->pScreen->
+	    GetWindowPixmap((WindowPtr) pDraw) : (PixmapPtr) pDraw;
+	PVR2DMEMINFO *meminfo;
+	long xoff, yoff;
+	BoxPtr box = REGION_RECTS(region);
+	int n = REGION_NUM_RECTS(region);
+	int x1, y1, x2, y2;
+
+	if (!getDrawableInfo(pDraw, &meminfo, &xoff, &yoff))
+		return FALSE;
+
+	if (!PVR2DPrepareSolid(pPixmap, GXcopy, ~0, fg))
+		return FALSE;
+
+	for (; n--; box++) {
+		x1 = max(box->x1 + xoff, 0);
+		y1 = max(box->y1 + yoff, 0);
+		x2 = min(box->x2 + xoff, pPixmap->drawable.width);
+		y2 = min(box->y2 + yoff, pPixmap->drawable.height);
+
+		if (x1 < x2 && y1 < y2)
+			PVR2DSolid(pPixmap, x1, y1, x2, y2);
+	}
+
+	PVR2DDoneSolid(pPixmap);
+
+	return TRUE;
+}
+
 /* Heuristics for choosing between software and hardware copy.
  * The heuristics will choose the solution that will take less CPU time
  * returns	TRUE  : Software solid fill is faster
@@ -929,6 +968,7 @@ static void PVR2DDestroyPixmap(ScreenPtr pScreen, void *driverPriv)
 		x_hash_table_remove(pixmapsHT, ppix);
 
 	if (ppix) {
+		omap_scanout_forget(ppix);
 		DestroyPVR2DMemory(ppix);
 		free(ppix);
 	}
@@ -984,6 +1024,7 @@ static Bool PVR2DModifyPixmapHeader(PixmapPtr pPixmap, int width, int height,
 	    || bitsPerPixel != pPixmap->drawable.bitsPerPixel || pPixData
 	    || (ppix->pvr2dmem == pSysMemInfo && !pPixData)) {
 
+		omap_scanout_forget(ppix);
 		DestroyPVR2DMemory(ppix);
 		ppix->screen = FALSE;
 		ppix->pvr2dmem = NULL;
@@ -993,13 +1034,17 @@ static Bool PVR2DModifyPixmapHeader(PixmapPtr pPixmap, int width, int height,
 #endif /* USE_MALLOC */
 		ppix->shmaddr = NULL;
 		ppix->shmid = -1;
+		ppix->scanout = 0;
 #endif
 
 		if (!pPixData) {
 #if USE_SHM
 			ppix->shmsize = pitch * height;
 			if (ppix->usage_hint == CREATE_PIXMAP_USAGE_BACKING_PIXMAP) {
-				PVR2DAllocSHM(ppix);
+				if (!omap_scanout_alloc(pPixmap->drawable.pScreen,
+							ppix, width, height, depth,
+							bitsPerPixel, pitch))
+					PVR2DAllocSHM(ppix);
 			}
 #if USE_MALLOC
 			else {
@@ -33,6 +33,9 @@ extern int getSGXPitchAlign(int width);
 
 extern Bool GetPVR2DFormat(int depth, PVR2DFORMAT * format);
 
+extern Bool PVR2DFillRegion(DrawablePtr pDraw, Pixel fg,
+			    RegionPtr region);
+
 extern void PVR2DUnmapAllPixmaps(void);
 
 extern void SysMemInfoChanged(void);
@@ -23,6 +23,9 @@
 #include "fbdev.h"
 #include "sgx_pvr2d.h"
 #include "services.h"
+#include "omap_scanout.h"
+
+#include <string.h>
 
 #if USE_SHM
 #include <sys/shm.h>
@@ -104,6 +107,38 @@ Bool PVR2D_PreFBReset(void)
 	return TRUE;
 }
 
+/*
+ * PVR2DClearFrameBuffer
+ *
+ * Clears the top left width x height of the framebuffer to black on the
+ * SGX, waiting for it to finish.
+ */
+Bool PVR2DClearFrameBuffer(long width, long height, long stride, int depth)
+{
+	PVR2DBLTINFO blt;
+
+	memset(&blt, 0, sizeof(blt));
+
+	if (!pSysMemInfo || !GetPVR2DFormat(depth, &blt.DstFormat))
+		return FALSE;
+
+	blt.CopyCode = PVR2DPATROPcopy;
+	blt.BlitFlags = PVR2D_BLIT_DISABLE_ALL;
+	blt.Colour = 0;
+	blt.pDstMemInfo = pSysMemInfo;
+	blt.DstSurfWidth = width;
+	blt.DstSurfHeight = height;
+	blt.DstStride = stride;
+	blt.DSizeX = width;
+	blt.DSizeY = height;
+
+	if (PVR2DBlt(hPVR2DContext, &blt) != PVR2D_OK)
+		return FALSE;
+
+	PVR2DQueryBlitsComplete(hPVR2DContext, pSysMemInfo, TRUE);
+
+	return TRUE;
+}
 
 Bool PVR2D_Init(void)
 {
@@ -343,6 +378,18 @@ static void DoDestroyPVR2DMemory(struct PVR2DPixmap *ppix)
 {
 	CALLTRACE("%s: Start\n", __func__);
 
+#if USE_SHM
+	/* Plane memory, not ours to cache. */
+	if (ppix->scanout) {
+		PVR2DMemFree(hPVR2DContext, ppix->pvr2dmem);
+		ppix->pvr2dmem = NULL;
+		ppix->shmaddr = NULL;
+		omap_scanout_free(ppix->scanout - 1);
+		ppix->scanout = 0;
+		return;
+	}
+#endif
+
 #if SGX_CACHE_SEGMENTS
 	if (AddToCache
 	    (ppix->shmid, ppix->shmaddr, ppix->pvr2dmem, ppix->mallocaddr,
@@ -61,6 +61,7 @@ struct PVR2DPixmap {
 #if USE_MALLOC
 	void *mallocaddr;
 #endif /* USE_MALLOC */
+	int scanout;		// video plane + 1, see omap_scanout.c
 #endif
 	int usage_hint;
 };
@@ -92,6 +93,7 @@ Bool PVR2D_Init(void);
 void PVR2D_DeInit(void);
 Bool PVR2D_PostFBReset(void);
 Bool PVR2D_PreFBReset(void);
+Bool PVR2DClearFrameBuffer(long width, long height, long stride, int depth);
 #if USE_MALLOC && USE_SHM
 Bool PVR2DAllocNormal(struct PVR2DPixmap *ppix);
 #endif
@@ -0,0 +1,333 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * SGX rotation.
+ *
+ * The frame buffer stays in panel orientation and the root gets its own
+ * pixmap in screen orientation.  Damage to the root is copied across at
+ * BlockHandler time: by the SGX with its rotating blits, or for small
+ * boxes, where setting up a blit costs more than the copy, by the CPU
+ * with the omap_copy_* converters.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fbdev.h"
+#include <string.h>
+
+#include "exa.h"
+
+#include "sgx_pvr2d.h"
+#include "sgx_rotate.h"
+#include "omap_damage.h"
+#include "omap_hold.h"
+#include "omap_update.h"
+#include "omap_video_formats.h"
+
+/* Boxes up to this many pixels are copied by the CPU. */
+#define ROTATE_CPU_PIXELS (64 * 64)
+
+struct sgx_rotate {
+	ScreenPtr screen;
+	Rotation rotation;
+
+	/* Root pixmap being copied. */
+	struct omap_damage track;
+
+	void (*block_handler) (int, pointer, pointer, pointer);
+};
+
+/* The root only gets its own pixmap once the server has rotated; while
+ * it's still the frame buffer there's nothing to copy. */
+static Bool off_screen(PixmapPtr pixmap)
+{
+	struct PVR2DPixmap *ppix = exaGetPixmapDriverPrivate(pixmap);
+
+	return ppix && !ppix->screen;
+}
+
+/* Where box lands on the panel, for a w x h root. */
+static void panel_box(Rotation rotation, int w, int h, BoxPtr box,
+		      BoxPtr out)
+{
+	switch (rotation) {
+	case RR_Rotate_90:
+		out->x1 = box->y1;
+		out->x2 = box->y2;
+		out->y1 = w - box->x2;
+		out->y2 = w - box->x1;
+		break;
+	case RR_Rotate_180:
+		out->x1 = w - box->x2;
+		out->x2 = w - box->x1;
+		out->y1 = h - box->y2;
+		out->y2 = h - box->y1;
+		break;
+	case RR_Rotate_270:
+		out->x1 = h - box->y2;
+		out->x2 = h - box->y1;
+		out->y1 = box->x1;
+		out->y2 = box->x2;
+		break;
+	default:
+		*out = *box;
+		break;
+	}
+}
+
+static CARD8 *pixmap_addr(struct PVR2DPixmap *ppix)
+{
+#if USE_SHM
+#if USE_MALLOC
+	if (ppix->mallocaddr)
+		return ppix->mallocaddr;
+#endif /* USE_MALLOC */
+	if (ppix->shmaddr)
+		return ppix->shmaddr;
+#endif
+	return ppix->pvr2dmem ? ppix->pvr2dmem->pBase : NULL;
+}
+
+/* Both PVR2D and RandR count counter-clockwise. */
+static PVR2DBLITFLAGS blit_flags(Rotation rotation)
+{
+	switch (rotation) {
+	case RR_Rotate_90:
+		return PVR2D_BLIT_ROT_90;
+	case RR_Rotate_180:
+		return PVR2D_BLIT_ROT_180;
+	case RR_Rotate_270:
+		return PVR2D_BLIT_ROT_270;
+	default:
+		return PVR2D_BLIT_DISABLE_ALL;
+	}
+}
+
+static Bool copy_gpu(struct sgx_rotate *rotate, ScrnInfoPtr pScrn,
+		     BoxPtr box, BoxPtr out)
+{
+	PixmapPtr pixmap = rotate->track.pixmap;
+	struct PVR2DPixmap *ppix = exaGetPixmapDriverPrivate(pixmap);
+	PVR2DBLTINFO blt;
+
+	if (!PVR2DValidate(ppix, FALSE))
+		return FALSE;
+
+	memset(&blt, 0, sizeof(blt));
+	if (!GetPVR2DFormat(pixmap->drawable.depth, &blt.SrcFormat))
+		return FALSE;
+	blt.DstFormat = blt.SrcFormat;
+
+	blt.CopyCode = PVR2DROPcopy;
+	blt.BlitFlags = blit_flags(rotate->rotation);
+
+	blt.pSrcMemInfo = ppix->pvr2dmem;
+	blt.SrcStride = pixmap->devKind;
+	blt.SrcSurfWidth = pixmap->drawable.width;
+	blt.SrcSurfHeight = pixmap->drawable.height;
+	blt.SrcX = box->x1;
+	blt.SrcY = box->y1;
+	blt.SizeX = box->x2 - box->x1;
+	blt.SizeY = box->y2 - box->y1;
+
+	/* The destination rectangle is given as it is on the panel. */
+	blt.pDstMemInfo = pSysMemInfo;
+	blt.DstStride = fbdevHWGetLineLength(pScrn);
+	blt.DstSurfWidth = FBDEVPTR(pScrn)->builtin->HDisplay;
+	blt.DstSurfHeight = FBDEVPTR(pScrn)->builtin->VDisplay;
+	blt.DstX = out->x1;
+	blt.DstY = out->y1;
+	blt.DSizeX = out->x2 - out->x1;
+	blt.DSizeY = out->y2 - out->y1;
+
+	PVR2DPixmapOwnership_GPU(ppix);
+
+	return PVR2DBlt(hPVR2DContext, &blt) == PVR2D_OK;
+}
+
+static void copy_cpu(struct sgx_rotate *rotate, ScrnInfoPtr pScrn,
+		     CARD8 * src, BoxPtr box, BoxPtr out)
+{
+	FBDevPtr fbdev = FBDEVPTR(pScrn);
+	PixmapPtr pixmap = rotate->track.pixmap;
+	int pitch = fbdevHWGetLineLength(pScrn);
+	CARD8 *dst = fbdev->fbmem + fbdev->fboff + out->y1 * pitch +
+	    out->x1 * (pixmap->drawable.bitsPerPixel >> 3);
+	int w = box->x2 - box->x1, h = box->y2 - box->y1;
+
+	if (pixmap->drawable.bitsPerPixel == 32)
+		omap_copy_32(src, dst, rotate->rotation, pixmap->devKind,
+			     pitch, w, h, box->x1, box->y1, w, h);
+	else
+		omap_copy_16(src, dst, rotate->rotation, pixmap->devKind,
+			     pitch, w, h, box->x1, box->y1, w, h);
+}
+
+static void copy_damage(struct sgx_rotate *rotate)
+{
+	ScreenPtr screen = rotate->screen;
+	ScrnInfoPtr pScrn = xf86Screens[screen->myNum];
+	FBDevPtr fbdev = FBDEVPTR(pScrn);
+	PixmapPtr pixmap;
+	struct PVR2DPixmap *ppix;
+	RegionRec clip;
+	BoxRec bounds, out;
+	BoxPtr boxes;
+	CARD8 *src = NULL;
+	int i, n;
+
+	/* All of a new pixmap has to be copied. */
+	if (!omap_damage_track(&rotate->track, off_screen, TRUE))
+		return;
+	pixmap = rotate->track.pixmap;
+	ppix = exaGetPixmapDriverPrivate(pixmap);
+
+	if (!REGION_NOTEMPTY(screen, DamageRegion(rotate->track.damage)))
+		return;
+
+	/* Leave it pending until the panel is back on. */
+	if (!omap_output_visible(fbdev, NULL))
+		return;
+
+	bounds.x1 = 0;
+	bounds.y1 = 0;
+	bounds.x2 = pixmap->drawable.width;
+	bounds.y2 = pixmap->drawable.height;
+	REGION_INIT(screen, &clip, &bounds, 1);
+	REGION_INTERSECT(screen, &clip, &clip,
+			 DamageRegion(rotate->track.damage));
+	DamageEmpty(rotate->track.damage);
+
+	n = omap_damage_boxes(screen, &clip, &boxes);
+
+	for (i = 0; i < n; i++) {
+		BoxPtr box = &boxes[i];
+		int w = box->x2 - box->x1, h = box->y2 - box->y1;
+
+		if (w <= 0 || h <= 0)
+			continue;
+
+		panel_box(rotate->rotation, bounds.x2, bounds.y2, box, &out);
+
+		if (w * h > ROTATE_CPU_PIXELS && copy_gpu(rotate, pScrn, box,
+							  &out)) {
+			omap_update_add(fbdev, &out);
+			continue;
+		}
+
+		/* The CPU has to wait for rendering to the root, and for
+		 * blits still on their way to the panel, once. */
+		if (!src) {
+			if (!PVR2DPixmapOwnership_CPU(ppix))
+				break;
+			PVR2DQueryBlitsComplete(hPVR2DContext, pSysMemInfo,
+						TRUE);
+			src = pixmap_addr(ppix);
+			if (!src)
+				break;
+		}
+
+		copy_cpu(rotate, pScrn, src, box, &out);
+		omap_update_add(fbdev, &out);
+	}
+
+	REGION_UNINIT(screen, &clip);
+}
+
+static void rotate_block_handler(int i, pointer blockData, pointer pTimeout,
+				 pointer pReadmask)
+{
+	ScreenPtr screen = screenInfo.screens[i];
+	struct sgx_rotate *rotate = FBDEVPTR(xf86Screens[i])->rotate;
+
+	screen->BlockHandler = rotate->block_handler;
+	(*screen->BlockHandler) (i, blockData, pTimeout, pReadmask);
+	screen->BlockHandler = rotate_block_handler;
+
+	if (rotate->rotation != RR_Rotate_0)
+		copy_damage(rotate);
+}
+
+Bool sgx_rotate_active(FBDevPtr fbdev)
+{
+	return fbdev->rotate && fbdev->rotate->rotation != RR_Rotate_0;
+}
+
+void sgx_rotate_set(FBDevPtr fbdev, Rotation rotation)
+{
+	struct sgx_rotate *rotate = fbdev->rotate;
+
+	if (!rotate)
+		return;
+
+	rotate->rotation = rotation;
+	/* Picked up afresh with the next copy. */
+	omap_damage_untrack(&rotate->track);
+}
+
+Bool sgx_rotate_init(ScreenPtr screen)
+{
+	ScrnInfoPtr pScrn = xf86Screens[screen->myNum];
+	FBDevPtr fbdev = FBDEVPTR(pScrn);
+	struct sgx_rotate *rotate;
+
+	rotate = xcalloc(1, sizeof(*rotate));
+	if (!rotate)
+		return FALSE;
+
+	rotate->screen = screen;
+	rotate->rotation = RR_Rotate_0;
+	if (!omap_damage_init(&rotate->track, screen)) {
+		xfree(rotate);
+		return FALSE;
+	}
+
+	rotate->block_handler = screen->BlockHandler;
+	screen->BlockHandler = rotate_block_handler;
+	fbdev->rotate = rotate;
+
+	xf86DrvMsg(pScrn->scrnIndex, X_INFO,
+		   "Rotating with the SGX, %s converters for small areas\n",
+		   omap_copy_impl());
+
+	return TRUE;
+}
+
+void sgx_rotate_fini(ScreenPtr screen)
+{
+	FBDevPtr fbdev = FBDEVPTR(xf86Screens[screen->myNum]);
+	struct sgx_rotate *rotate = fbdev->rotate;
+
+	if (!rotate)
+		return;
+
+	if (screen->BlockHandler == rotate_block_handler)
+		screen->BlockHandler = rotate->block_handler;
+
+	omap_damage_fini(&rotate->track);
+
+	xfree(rotate);
+	fbdev->rotate = NULL;
+}
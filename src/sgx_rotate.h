@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2008, 2009  Nokia Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SGX_ROTATE_H
+#define SGX_ROTATE_H
+
+#include "fbdev.h"
+
+/*
+ * Rotation by copying an unrotated shadow of the root to the frame buffer,
+ * for when the DSS can't rotate or is too slow at it.
+ */
+Bool sgx_rotate_init(ScreenPtr screen);
+void sgx_rotate_fini(ScreenPtr screen);
+
+/**
+ * Start copying the root to the panel rotated by rotation, or stop for
+ * RR_Rotate_0, where the root is the frame buffer again.
+ */
+void sgx_rotate_set(FBDevPtr fbdev, Rotation rotation);
+
+/**
+ * Whether the root is being copied rotated, so the frame buffer is in
+ * panel rather than screen coordinates.
+ */
+Bool sgx_rotate_active(FBDevPtr fbdev);
+
+#endif
@@ -24,11 +24,14 @@
 #include "sgx_pvr2d.h"
 #include "sgx_exa.h"
 #include "omap_video.h"
+#include "omap_video_formats.h"
+#include "omap_hold.h"
 
 #include "xf86xv.h"
 #include <X11/extensions/Xv.h>
 #include "fourcc.h"
 #include "damage.h"
+#include "windowstr.h"
 
 #define BRIGHTNESS_DEFAULT_VALUE   0
 #define BRIGHTNESS_MIN            -50
@@ -46,17 +49,42 @@
 #define HUE_MIN            -30
 #define HUE_MAX             30
 
+/* Bit 0 selects the BT.709 matrix, bit 1 full (0-255) range input. */
+enum {
+	COLORSPACE_BT601 = 0,
+	COLORSPACE_BT709 = 1,
+	COLORSPACE_BT601_FULL = 2,
+	COLORSPACE_BT709_FULL = 3,
+};
+
+#define COLORSPACE_DEFAULT_VALUE   COLORSPACE_BT601
+#define COLORSPACE_MIN             COLORSPACE_BT601
+#define COLORSPACE_MAX             COLORSPACE_BT709_FULL
+
 #define NUM_TEXTURED_XV_PORTS 2
 
-static Atom xvBrightness, xvContrast, xvHue, xvSaturation;
+/* Buffers requested for the fullscreen flip chain. */
+#define FLIP_CHAIN_BUFFERS 3
+
+static Atom xvBrightness, xvContrast, xvHue, xvSaturation, xvColorspace;
+
+struct _Mem {
+	PVR2DMEMINFO *pMemInfo;
+	unsigned size;
+};
 
 typedef struct _pvr2DPortPrivRec {
 	int brightness;
 	int contrast;
 	int saturation;
 	int hue;
+	int colorspace;
 	unsigned long sgx_packed_filtervalues[9];
 	unsigned long sgx_planar_filtervalues[9];
+	/* ARGB ping-pong surfaces for downscaling by more than 2x. */
+	struct _Mem scratch[2];
+	/* Latest frame put while it couldn't be seen. */
+	struct omap_hold hold;
 } pvr2DPortPrivRec, *pvr2DPortPrivPtr;
 
 static XF86VideoEncodingRec DummyEncoding = {
@@ -76,6 +104,8 @@ static XF86AttributeRec Attributes[] = {
 	{XvSettable | XvGettable, SATURATION_MIN, SATURATION_MAX,
 	 "XV_SATURATION"},
 	{XvSettable | XvGettable, HUE_MIN, HUE_MAX, "XV_HUE"},
+	{XvSettable | XvGettable, COLORSPACE_MIN, COLORSPACE_MAX,
+	 "XV_COLORSPACE"},
 };
 
 static XF86ImageRec Images[] = {
@@ -83,6 +113,8 @@ static XF86ImageRec Images[] = {
 	XVIMAGE_YUY2,
 	XVIMAGE_YV12,
 	XVIMAGE_I420,
+	XVIMAGE_NV12,
+	XVIMAGE_NV21,
 };
 
 static void pvr2DQueryBestSize(ScrnInfoPtr pScrn, Bool motion, short vid_w,
@@ -90,24 +122,121 @@ static void pvr2DQueryBestSize(ScrnInfoPtr pScrn, Bool motion, short vid_w,
 			       unsigned int *p_w, unsigned int *p_h,
 			       pointer data)
 {
-	if (vid_w > (drw_w << 1))
-		drw_w = vid_w >> 1;
-	if (vid_h > (drw_h << 1))
-		drw_h = vid_h >> 1;
+	/* Anything beyond 2x is reduced in halving passes before the blit. */
+	if (drw_w < 1)
+		drw_w = 1;
+	if (drw_h < 1)
+		drw_h = 1;
 
 	*p_w = drw_w;
 	*p_h = drw_h;
 }
 
+/*
+ * Colour conversion is done by the SGX using signed 8 bit coefficients and
+ * a 16 bit constant per output channel, all scaled by 2^shift. Everything
+ * below is computed in 16.16 fixed point and only rounded to the hardware
+ * representation at the very end.
+ */
+#define CSC_ONE (1 << 16)
+
+/* V->R, U->G, V->G and U->B factors of the BT.601 and BT.709 matrices. */
+static const int csc_matrix[2][4] = {
+	{ 91881, -22553, -46802, 116130 },
+	{ 103206, -12276, -30679, 121609 },
+};
+
+/* sin/cos of 0..30 degrees, covering the whole XV_HUE range. */
+static const int csc_sin[HUE_MAX + 1] = {
+	0, 1144, 2287, 3430, 4572, 5712, 6850, 7987, 9121, 10252, 11380,
+	12505, 13626, 14742, 15855, 16962, 18064, 19161, 20252, 21336, 22415,
+	23486, 24550, 25607, 26656, 27697, 28729, 29753, 30767, 31772, 32768,
+};
+
+static const int csc_cos[HUE_MAX + 1] = {
+	65536, 65526, 65496, 65446, 65376, 65287, 65177, 65048, 64898, 64729,
+	64540, 64332, 64104, 63856, 63589, 63303, 62997, 62672, 62328, 61966,
+	61584, 61183, 60764, 60326, 59870, 59396, 58903, 58393, 57865, 57319,
+	56756,
+};
+
+static _X_INLINE int csc_mul(int a, int b)
+{
+	return (int)(((long long)a * b) >> 16);
+}
+
+/* Round a 16.16 value to an integer scaled by 2^shift. */
+static _X_INLINE int csc_round(int v, int shift)
+{
+	return (int)((((long long)v << shift) + (CSC_ONE >> 1)) >> 16);
+}
+
+/*
+ * Pick the largest shift (up to the 7 the fixed BT.601 table used) for
+ * which all coefficients of a channel still fit the filter taps. Luma may
+ * be split over two taps unless the channel only has one luma tap.
+ */
+static int pvr2DFitShift(int y, int u, int v, int c, Bool split_y)
+{
+	int shift;
+	int ymax = split_y ? 254 : 127;
+
+	for (shift = 7; shift > 0; shift--) {
+		int ys = csc_round(y, shift);
+		int us = csc_round(u, shift);
+		int vs = csc_round(v, shift);
+		int cs = csc_round(c, shift);
+
+		if (ys >= -128 && ys <= ymax && us >= -128 && us <= 127
+		    && vs >= -128 && vs <= 127 && cs >= -32768 && cs <= 32767)
+			break;
+	}
+
+	return shift;
+}
+
 static void pvr2DSetupFilterValues(pvr2DPortPrivPtr pPriv)
 {
 	unsigned long *sgx_filtervalues = pPriv->sgx_packed_filtervalues;
-	//                  Red,  Green, Blue
-	short rgbYi[3] = { 75, 149, 37 };	// Y component
-	short rgbUi[3] = { 0, -50, 65 };	// U component
-	short rgbVi[3] = { 102, -104, 0 };	// V component
-	short rgbConst[3] = { -14267, 17354, -8859 };
-	short rgbShift[3] = { 6, 7, 5 };
+	const int *m = csc_matrix[pPriv->colorspace & COLORSPACE_BT709];
+	Bool full_range = !!(pPriv->colorspace & COLORSPACE_BT601_FULL);
+	int yscale = full_range ? CSC_ONE : 76309;	/* 255/219 */
+	int cscale = full_range ? CSC_ONE : 74606;	/* 255/224 */
+	int yoff = full_range ? 0 : 16;
+	int contrast = (100 + pPriv->contrast) * CSC_ONE / 100;
+	int saturation = pPriv->saturation * CSC_ONE / 100;
+	int brightness = pPriv->brightness * 255 * CSC_ONE / 100;
+	int hue = pPriv->hue;
+	int sinh, cosh, ky, kc;
+	int coefY[3], coefU[3], coefV[3], coefC[3];
+	short rgbYi[3], rgbUi[3], rgbVi[3], rgbConst[3], rgbShift[3];
+	int i;
+
+	sinh = hue < 0 ? -csc_sin[-hue] : csc_sin[hue];
+	cosh = hue < 0 ? csc_cos[-hue] : csc_cos[hue];
+
+	ky = csc_mul(yscale, contrast);
+	kc = csc_mul(csc_mul(cscale, contrast), saturation);
+
+	/* Rotate (U, V) by the hue angle, then apply the matrix. */
+	coefU[0] = csc_mul(kc, csc_mul(m[0], sinh));
+	coefV[0] = csc_mul(kc, csc_mul(m[0], cosh));
+	coefU[1] = csc_mul(kc, csc_mul(m[1], cosh) + csc_mul(m[2], sinh));
+	coefV[1] = csc_mul(kc, csc_mul(m[2], cosh) - csc_mul(m[1], sinh));
+	coefU[2] = csc_mul(kc, csc_mul(m[3], cosh));
+	coefV[2] = -csc_mul(kc, csc_mul(m[3], sinh));
+
+	for (i = 0; i < 3; i++) {
+		coefY[i] = ky;
+		coefC[i] = brightness - ky * yoff - 128 * (coefU[i] + coefV[i]);
+
+		rgbShift[i] = pvr2DFitShift(coefY[i], coefU[i], coefV[i],
+					    coefC[i], i != 2);
+		rgbYi[i] = csc_round(coefY[i], rgbShift[i]);
+		rgbUi[i] = csc_round(coefU[i], rgbShift[i]);
+		rgbVi[i] = csc_round(coefV[i], rgbShift[i]);
+		rgbConst[i] = csc_round(coefC[i], rgbShift[i]);
+	}
 
 	// In the filter set 2 only taps (bytes) 1,4,7 can be used (counting from 1, left to right 12345678)
 
@@ -153,14 +282,17 @@ static int pvr2DSetPortAttribute(ScrnInfoPtr pScrn, Atom attribute, INT32 value,
 
 	if (attribute == xvBrightness) {
 		pPriv->brightness =
-		    ClipValue(value, BRIGHTNESS_MAX, BRIGHTNESS_MIN);
+		    ClipValue(value, BRIGHTNESS_MIN, BRIGHTNESS_MAX);
 	} else if (attribute == xvContrast) {
-		pPriv->contrast = ClipValue(value, CONTRAST_MAX, CONTRAST_MIN);
+		pPriv->contrast = ClipValue(value, CONTRAST_MIN, CONTRAST_MAX);
 	} else if (attribute == xvSaturation) {
 		pPriv->saturation =
-		    ClipValue(value, SATURATION_MAX, SATURATION_MIN);
+		    ClipValue(value, SATURATION_MIN, SATURATION_MAX);
 	} else if (attribute == xvHue) {
-		pPriv->hue = ClipValue(value, HUE_MAX, HUE_MIN);
+		pPriv->hue = ClipValue(value, HUE_MIN, HUE_MAX);
+	} else if (attribute == xvColorspace) {
+		pPriv->colorspace =
+		    ClipValue(value, COLORSPACE_MIN, COLORSPACE_MAX);
 	} else
 		return BadValue;
 
@@ -182,6 +314,8 @@ static int pvr2DGetPortAttribute(ScrnInfoPtr pScrn, Atom attribute,
 		*value = pPriv->saturation;
 	else if (attribute == xvHue)
 		*value = pPriv->hue;
+	else if (attribute == xvColorspace)
+		*value = pPriv->colorspace;
 	else
 		return BadValue;
 
@@ -222,6 +356,17 @@ static int pvr2DQueryImageAttributes(ScrnInfoPtr pScrn, int id,
 			offsets[2] = size;
 		size += tmp;
 		break;
+	case FOURCC_NV12:
+	case FOURCC_NV21:
+		*h = (*h + 1) & ~1;
+		size = (*w + 3) & ~3;
+		if (pitches)
+			pitches[0] = pitches[1] = size;
+		size *= *h;
+		if (offsets)
+			offsets[1] = size;
+		size += size >> 1;
+		break;
 	case FOURCC_UYVY:
 	case FOURCC_YUY2:
 	default:
@@ -239,10 +384,7 @@ static int pvr2DQueryImageAttributes(ScrnInfoPtr pScrn, int id,
 static PVR2DEXTBLTINFO pvr2dextblt;
 /* putImage needs 1 source surface for packed and 3 source surfaces for planar formats.
  * We keep two sets of source surfaces for asynchronous operation */
-static struct _Mem {
-	PVR2DMEMINFO *pMemInfo;
-	unsigned size;
-} MemSet[2][3], *pMem;
+static struct _Mem MemSet[2][3], *pMem;
 
 static void freeMem(struct _Mem *pMem)
 {
@@ -276,8 +418,12 @@ static Bool allocMem(struct _Mem *pMem, unsigned size)
 
 void pvr2DStopVideo(ScrnInfoPtr pScrn, pointer data, Bool cleanup)
 {
+	pvr2DPortPrivPtr pPriv = (pvr2DPortPrivPtr) data;
+
 	DBG("%s(pScrn, %p, %s\n", __func__, data, cleanup ? "TRUE" : "FALSE");
 
+	omap_hold_drop(&pPriv->hold);
+
 	if (cleanup) {
 		int i;
 
@@ -285,9 +431,217 @@ void pvr2DStopVideo(ScrnInfoPtr pScrn, pointer data, Bool cleanup)
 			freeMem(&MemSet[0][i]);
 			freeMem(&MemSet[1][i]);
 		}
+
+		for (i = 0; i < 2; i++)
+			freeMem(&pPriv->scratch[i]);
+
+		if (FlipChain.owner == pPriv)
+			pvr2DDestroyFlipChain();
 	}
 }
 
+/*
+ * Fullscreen unobscured video is converted into the back buffer of a PVR2D
+ * flip chain, which the display then flips to at vblank, instead of being
+ * blitted into the visible framebuffer.
+ */
+static struct {
+	PVR2DFLIPCHAINHANDLE handle;
+	PVR2DMEMINFO *buffers[FLIP_CHAIN_BUFFERS];
+	unsigned long num_buffers;
+	unsigned long current;
+	long width, height, stride;
+	PVR2DFORMAT format;
+	pvr2DPortPrivPtr owner;
+	/* Screen size, if any, at which no flip chain could be had. */
+	int failed_width, failed_height;
+} FlipChain;
+
+void pvr2DDestroyFlipChain(void)
+{
+	int failed_width = FlipChain.failed_width;
+	int failed_height = FlipChain.failed_height;
+	unsigned long i;
+
+	if (FlipChain.handle) {
+		for (i = 0; i < FlipChain.num_buffers; i++)
+			PVR2DQueryBlitsComplete(hPVR2DContext,
+						FlipChain.buffers[i], 1);
+		if (PVR2DDestroyFlipChain(hPVR2DContext, FlipChain.handle) !=
+		    PVR2D_OK)
+			ErrorF("PVR2DDestroyFlipChain failed\n");
+		DBG("%s: flip chain destroyed\n", __func__);
+	}
+
+	/* Not worth trying, or warning about, again until rotated. */
+	memset(&FlipChain, 0, sizeof(FlipChain));
+	FlipChain.failed_width = failed_width;
+	FlipChain.failed_height = failed_height;
+}
+
+static Bool pvr2DCreateFlipChain(ScreenPtr pScreen, PVR2DFORMAT format)
+{
+	PVR2DDISPLAYINFO info;
+	unsigned long id;
+	long width, height, stride;
+	int refresh;
+	PVR2DFORMAT mode_format;
+
+	if (PVR2DGetDeviceInfo(hPVR2DContext, &info) != PVR2D_OK
+	    || info.ulMaxFlipChains < 1 || info.ulMaxBuffersInChain < 2)
+		return FALSE;
+
+	if (PVR2DGetScreenMode(hPVR2DContext, &mode_format, &width, &height,
+			       &stride, &refresh) != PVR2D_OK
+	    || mode_format != format || width != pScreen->width
+	    || height != pScreen->height)
+		return FALSE;
+
+	FlipChain.num_buffers = min(info.ulMaxBuffersInChain,
+				    FLIP_CHAIN_BUFFERS);
+	if (PVR2DCreateFlipChain(hPVR2DContext, 0, FlipChain.num_buffers,
+				 width, height, format, &FlipChain.stride, &id,
+				 &FlipChain.handle) != PVR2D_OK) {
+		FlipChain.handle = NULL;
+		return FALSE;
+	}
+
+	if (PVR2DGetFlipChainBuffers(hPVR2DContext, FlipChain.handle,
+				     &FlipChain.num_buffers,
+				     FlipChain.buffers) != PVR2D_OK
+	    || FlipChain.num_buffers < 2
+	    || PVR2DSetPresentFlipProperties(hPVR2DContext, FlipChain.handle,
+					     PVR2D_PRESENT_PROPERTY_INTERVAL,
+					     0, 0, 0, NULL, 1) != PVR2D_OK) {
+		pvr2DDestroyFlipChain();
+		return FALSE;
+	}
+
+	FlipChain.width = width;
+	FlipChain.height = height;
+	FlipChain.format = format;
+
+	DBG("%s: %ldx%ld, %lu buffers\n", __func__, width, height,
+	    FlipChain.num_buffers);
+
+	return TRUE;
+}
+
+/*
+ * The flip path is only usable while the video window covers the whole
+ * screen, nothing is on top of it, and it is drawn straight to the screen
+ * pixmap (not redirected).
+ */
+static Bool pvr2DFlipEligible(DrawablePtr pDraw, RegionPtr clipBoxes)
+{
+	ScreenPtr pScreen = pDraw->pScreen;
+	BoxPtr box;
+
+	if (pDraw->type != DRAWABLE_WINDOW
+	    || pvr2dextblt.pDstMemInfo != pSysMemInfo
+	    || ((WindowPtr) pDraw)->visibility != VisibilityUnobscured)
+		return FALSE;
+
+	if (pDraw->x > 0 || pDraw->y > 0
+	    || pDraw->x + pDraw->width < pScreen->width
+	    || pDraw->y + pDraw->height < pScreen->height)
+		return FALSE;
+
+	if (REGION_NUM_RECTS(clipBoxes) != 1)
+		return FALSE;
+
+	box = REGION_RECTS(clipBoxes);
+
+	return box->x1 == pvr2dextblt.DstX && box->y1 == pvr2dextblt.DstY
+	    && box->x2 == pvr2dextblt.DstX + pvr2dextblt.DSizeX
+	    && box->y2 == pvr2dextblt.DstY + pvr2dextblt.DSizeY;
+}
+
+/* Copy a box of the screen into a flip chain buffer. */
+static Bool pvr2DFlipCopy(PVR2DMEMINFO *back, int x1, int y1, int x2, int y2)
+{
+	PVR2DBLTINFO blt;
+
+	if (x1 >= x2 || y1 >= y2)
+		return TRUE;
+
+	memset(&blt, 0, sizeof(blt));
+	blt.CopyCode = PVR2DROPcopy;
+	blt.BlitFlags = PVR2D_BLIT_DISABLE_ALL;
+	blt.pDstMemInfo = back;
+	blt.DstStride = FlipChain.stride;
+	blt.DstFormat = FlipChain.format;
+	blt.DstSurfWidth = FlipChain.width;
+	blt.DstSurfHeight = FlipChain.height;
+	blt.DstX = blt.SrcX = x1;
+	blt.DstY = blt.SrcY = y1;
+	blt.pSrcMemInfo = pSysMemInfo;
+	blt.SrcStride = pvr2dextblt.DstStride;
+	blt.SrcFormat = pvr2dextblt.DstFormat;
+	blt.SrcSurfWidth = FlipChain.width;
+	blt.SrcSurfHeight = FlipChain.height;
+	blt.SizeX = blt.DSizeX = x2 - x1;
+	blt.SizeY = blt.DSizeY = y2 - y1;
+
+	return PVR2DBlt(hPVR2DContext, &blt) == PVR2D_OK;
+}
+
+/*
+ * Point the video blit at the next flip chain buffer. When the video does
+ * not cover the whole screen, the buffer first gets a copy of the screen
+ * around it, so letterbox borders match; they may have been drawn to
+ * since the buffer was last shown, so this is done on every flip.
+ */
+static Bool pvr2DFlipPrepare(ScrnInfoPtr pScrn, pvr2DPortPrivPtr pPriv,
+			     DrawablePtr pDraw)
+{
+	PVR2DMEMINFO *back;
+	int x1, y1, x2, y2;
+
+	if (FlipChain.owner && FlipChain.owner != pPriv)
+		return FALSE;
+
+	/* The root flips by itself, see omap_flip.c. */
+	if (FBDEVPTR(pScrn)->flip)
+		return FALSE;
+
+	if (!FlipChain.handle) {
+		if (FlipChain.failed_width == pDraw->pScreen->width
+		    && FlipChain.failed_height == pDraw->pScreen->height)
+			return FALSE;
+		if (!pvr2DCreateFlipChain(pDraw->pScreen,
+					  pvr2dextblt.DstFormat)) {
+			xf86DrvMsg(pScrn->scrnIndex, X_WARNING,
+				   "Textured video: no flip chain, fullscreen "
+				   "video will not be synchronized to vblank\n");
+			FlipChain.failed_width = pDraw->pScreen->width;
+			FlipChain.failed_height = pDraw->pScreen->height;
+			return FALSE;
+		}
+	}
+
+	FlipChain.owner = pPriv;
+	FlipChain.current = (FlipChain.current + 1) % FlipChain.num_buffers;
+	back = FlipChain.buffers[FlipChain.current];
+
+	x1 = pvr2dextblt.DstX;
+	y1 = pvr2dextblt.DstY;
+	x2 = x1 + pvr2dextblt.DSizeX;
+	y2 = y1 + pvr2dextblt.DSizeY;
+
+	/* Above, below, left and right of the video. */
+	if (!pvr2DFlipCopy(back, 0, 0, FlipChain.width, y1)
+	    || !pvr2DFlipCopy(back, 0, y2, FlipChain.width, FlipChain.height)
+	    || !pvr2DFlipCopy(back, 0, y1, x1, y2)
+	    || !pvr2DFlipCopy(back, x2, y1, FlipChain.width, y2))
+		return FALSE;
+
+	pvr2dextblt.pDstMemInfo = back;
+	pvr2dextblt.DstStride = FlipChain.stride;
+
+	return TRUE;
+}
+
 static int initSrcSurf(int surfNum, unsigned width, unsigned stride,
 		       unsigned height, void *buf, unsigned buf_stride)
 {
@@ -326,6 +680,165 @@ static int initSrcSurf(int surfNum, unsigned width, unsigned stride,
 	return Success;
 }
 
+/*
+ * Split an interleaved NV12/NV21 chroma plane straight into two planar
+ * source surfaces, so the semi-planar formats cost no more to upload than
+ * I420 does.
+ */
+static int initSrcSurfInterleaved(unsigned width, unsigned stride,
+				  unsigned height, void *buf,
+				  unsigned buf_stride)
+{
+	int i;
+
+	for (i = 1; i <= 2; i++) {
+		if (!allocMem(&pMem[i], stride * height))
+			return BadAlloc;
+
+		pvr2dextblt.SrcSurface[i].pSrcMemInfo = pMem[i].pMemInfo;
+		pvr2dextblt.SrcSurface[i].SrcFilterMode = PVR2D_FILTER_LINEAR;
+		pvr2dextblt.SrcSurface[i].SrcRepeatMode = PVR2D_REPEAT_NONE;
+		pvr2dextblt.SrcSurface[i].SrcSurfWidth = width;
+		pvr2dextblt.SrcSurface[i].SrcStride = stride;
+		pvr2dextblt.SrcSurface[i].SrcSurfHeight = height;
+
+		if (PVR2DQueryBlitsComplete(hPVR2DContext, pMem[i].pMemInfo, 0) != PVR2D_OK) {
+			DBG("%s: Pending blits!\n", __func__);
+			PVR2DQueryBlitsComplete(hPVR2DContext, pMem[i].pMemInfo, 1);
+		}
+	}
+
+	omap_copy_deinterleave(buf, pMem[1].pMemInfo->pBase,
+			       pMem[2].pMemInfo->pBase, buf_stride, stride,
+			       width, height);
+
+	return Success;
+}
+
+/* One step of the reduction: halve size unless it is within 2x already. */
+static int halveSize(int size, int target)
+{
+	return size > target << 1 ? (size + 1) >> 1 : size;
+}
+
+/* Describe (and if need be grow) scratch surface i as w x h ARGB. */
+static Bool pvr2DScratch(pvr2DPortPrivPtr pPriv, int i, int w, int h,
+			 PVR2D_SURFACE *surf)
+{
+	int align = getSGXPitchAlign(w) - 1;
+	long stride = ((w << 2) + align) & ~align;
+
+	if (!allocMem(&pPriv->scratch[i], stride * h))
+		return FALSE;
+
+	surf->pSurfMemInfo = pPriv->scratch[i].pMemInfo;
+	surf->SurfOffset = 0;
+	surf->Stride = stride;
+	surf->Format = PVR2D_ARGB8888;
+	surf->SurfWidth = w;
+	surf->SurfHeight = h;
+
+	return TRUE;
+}
+
+/*
+ * A linear filtered blit only samples every source pixel down to 2x, so
+ * larger reductions go through the port's scratch surfaces: the video
+ * blit converts to ARGB at up to 2x down, Blt3D halves that until what
+ * is left is within 2x, and a last Blt3D scales it into the destination.
+ * The CPU only ever uploads the source.
+ */
+static int pvr2DReduceBlt(pvr2DPortPrivPtr pPriv, float *texcoords,
+			  unsigned long *filtervalues, int src_w, int src_h,
+			  unsigned long surf_w, unsigned long surf_h)
+{
+	PVR2DEXTBLTINFO video = pvr2dextblt;
+	PVR2D_3DBLT blt;
+	int drw_w = pvr2dextblt.DSizeX, drw_h = pvr2dextblt.DSizeY;
+	int w = halveSize(src_w, drw_w), h = halveSize(src_h, drw_h);
+	int nw, nh, i = 0, passes = 1;
+
+	memset(&blt, 0, sizeof(blt));
+	if (!pvr2DScratch(pPriv, i, w, h, &blt.sSrc))
+		return BadAlloc;
+
+	video.pDstMemInfo = blt.sSrc.pSurfMemInfo;
+	video.DstOffset = 0;
+	video.DstStride = blt.sSrc.Stride;
+	video.DstX = video.DstY = 0;
+	video.DSizeX = w;
+	video.DSizeY = h;
+	video.DstFormat = PVR2D_ARGB8888;
+	video.DstSurfWidth = w;
+	video.DstSurfHeight = h;
+	if (PVR2DVideoBlt(hPVR2DContext, &video, texcoords, filtervalues) !=
+	    PVR2D_OK)
+		return BadImplementation;
+
+	for (;;) {
+		nw = halveSize(w, drw_w);
+		nh = halveSize(h, drw_h);
+
+		blt.rcSource.left = blt.rcSource.top = 0;
+		blt.rcSource.right = w;
+		blt.rcSource.bottom = h;
+
+		if (nw == w && nh == h) {
+			blt.sDst.pSurfMemInfo = pvr2dextblt.pDstMemInfo;
+			blt.sDst.SurfOffset = pvr2dextblt.DstOffset;
+			blt.sDst.Stride = pvr2dextblt.DstStride;
+			blt.sDst.Format = pvr2dextblt.DstFormat;
+			blt.sDst.SurfWidth = surf_w;
+			blt.sDst.SurfHeight = surf_h;
+			blt.rcDest.left = pvr2dextblt.DstX;
+			blt.rcDest.top = pvr2dextblt.DstY;
+			blt.rcDest.right = pvr2dextblt.DstX + drw_w;
+			blt.rcDest.bottom = pvr2dextblt.DstY + drw_h;
+		} else {
+			i ^= 1;
+			if (!pvr2DScratch(pPriv, i, nw, nh, &blt.sDst))
+				return BadAlloc;
+			blt.rcDest.left = blt.rcDest.top = 0;
+			blt.rcDest.right = nw;
+			blt.rcDest.bottom = nh;
+		}
+
+		if (PVR2DBlt3D(hPVR2DContext, &blt) != PVR2D_OK)
+			return BadImplementation;
+		passes++;
+
+		if (nw == w && nh == h)
+			break;
+
+		blt.sSrc = blt.sDst;
+		w = nw;
+		h = nh;
+	}
+
+	DBG("%s: %dx%d to %dx%d in %d passes\n", __func__, src_w, src_h,
+	    drw_w, drw_h, passes);
+
+	return Success;
+}
+
+/* The video blit proper, or the reduction for more than 2x down. */
+static int pvr2DBlit(pvr2DPortPrivPtr pPriv, float *texcoords,
+		     unsigned long *filtervalues, int src_w, int src_h,
+		     unsigned long surf_w, unsigned long surf_h)
+{
+	if (pvr2dextblt.DSizeX > 0 && pvr2dextblt.DSizeY > 0
+	    && (src_w > pvr2dextblt.DSizeX << 1
+		|| src_h > pvr2dextblt.DSizeY << 1))
+		return pvr2DReduceBlt(pPriv, texcoords, filtervalues, src_w,
+				      src_h, surf_w, surf_h);
+
+	if (PVR2DVideoBlt(hPVR2DContext, &pvr2dextblt, texcoords,
+			  filtervalues) != PVR2D_OK)
+		return BadImplementation;
+
+	return Success;
+}
+
 static int pvr2DPutImage(ScrnInfoPtr pScrn, short src_x, short src_y,
 			 short drw_x, short drw_y, short src_w, short src_h,
 			 short drw_w, short drw_h, int id, unsigned char *buf,
@@ -333,10 +846,12 @@ static int pvr2DPutImage(ScrnInfoPtr pScrn, short src_x, short src_y,
 			 RegionPtr clipBoxes, pointer data, DrawablePtr pDraw)
 {
 	pvr2DPortPrivPtr pPriv = (pvr2DPortPrivPtr) data;
+	PixmapPtr pPixmap;
 	float texcoords[4];
 	unsigned src_stride;
 	unsigned tex_stride;
 	int stride_align;
+	int vid_w = src_w, vid_h = src_h;
 	int ret;
 	unsigned long *sgx_filtervalues = 0;
 
@@ -346,6 +861,14 @@ static int pvr2DPutImage(ScrnInfoPtr pScrn, short src_x, short src_y,
 
 	DBG("%s(pScrn, %d, %d, %d, %d, %d, %d, %d, %d, %d, %p, %d, %d, %s, %p, %p, %p\n", __func__, src_x, src_y, drw_x, drw_y, src_w, src_h, drw_w, drw_h, id, buf, width, height, Sync ? "TRUE" : "FALSE", clipBoxes, data, pDraw);
 
+	if (!omap_output_visible(FBDEVPTR(pScrn), pDraw)) {
+		omap_hold_frame(&pPriv->hold, src_x, src_y, drw_x, drw_y,
+				src_w, src_h, drw_w, drw_h, id, buf, width,
+				height, pDraw);
+		return Success;
+	}
+	omap_hold_drop(&pPriv->hold);
+
 	if (!getDrawableInfo
 	    (pDraw, &pvr2dextblt.pDstMemInfo, &pvr2dextblt.DstX,
 	     &pvr2dextblt.DstY))
@@ -360,10 +883,10 @@ static int pvr2DPutImage(ScrnInfoPtr pScrn, short src_x, short src_y,
 	pvr2dextblt.DSizeY = drw_h;
 
 	if (pDraw->type == DRAWABLE_WINDOW)
-		pvr2dextblt.DstStride =
-		    pScrn->pScreen->GetWindowPixmap((WindowPtr) pDraw)->devKind;
+		pPixmap = pScrn->pScreen->GetWindowPixmap((WindowPtr) pDraw);
 	else
-		pvr2dextblt.DstStride = ((PixmapPtr) pDraw)->devKind;
+		pPixmap = (PixmapPtr) pDraw;
+	pvr2dextblt.DstStride = pPixmap->devKind;
 
 	stride_align = getSGXPitchAlign(width) - 1;
 
@@ -415,6 +938,34 @@ static int pvr2DPutImage(ScrnInfoPtr pScrn, short src_x, short src_y,
 		    initSrcSurf(2, width, tex_stride, height,
 				buf + src_y * src_stride + src_x, src_stride);
 		break;
+	case FOURCC_NV12:
+	case FOURCC_NV21:
+		/* The first chroma byte goes to surface 1 and the second to
+		 * surface 2, which is U, V for I420 and V, U for YV12. */
+		sgx_filtervalues = pPriv->sgx_planar_filtervalues;
+		pvr2dextblt.SrcSurface[0].SrcFormat =
+		    pvr2dextblt.SrcSurface[1].SrcFormat =
+		    pvr2dextblt.SrcSurface[2].SrcFormat =
+		    id == FOURCC_NV12 ? PVR2D_I420 : PVR2D_YV12;
+
+		/* Only the source rectangle is uploaded; its chroma starts
+		 * at the pair holding src_x. */
+		src_stride = (width + 3) & ~3;
+		ret =
+		    initSrcSurf(0, src_w,
+				(src_w + stride_align) & ~stride_align, src_h,
+				buf + src_y * src_stride + src_x, src_stride);
+		if (ret != Success)
+			break;
+		buf += ((height + 1) & ~1) * src_stride;
+		buf += (src_y >> 1) * src_stride + (src_x & ~1);
+
+		src_w = (src_w + 1) / 2;
+		src_h = (src_h + 1) / 2;
+		tex_stride = (src_w + stride_align) & ~stride_align;
+		ret = initSrcSurfInterleaved(src_w, tex_stride, src_h, buf,
+					     src_stride);
+		break;
 	default:
 		return BadMatch;
 	}
@@ -428,13 +979,40 @@ static int pvr2DPutImage(ScrnInfoPtr pScrn, short src_x, short src_y,
 	texcoords[2] = 1 /*(float)min(src_x + height, src_w) / (float)src_w */ ;
 	texcoords[3] = 1 /*(float)min(src_y + height, src_h) / (float)src_h */ ;
 
+	if (pvr2DFlipEligible(pDraw, clipBoxes)
+	    && pvr2DFlipPrepare(pScrn, pPriv, pDraw)) {
+		ret = pvr2DBlit(pPriv, texcoords, sgx_filtervalues, vid_w,
+				vid_h, FlipChain.width, FlipChain.height);
+		if (ret != Success)
+			return ret;
+		if (PVR2DPresentFlip(hPVR2DContext, FlipChain.handle,
+				     pvr2dextblt.pDstMemInfo, 0) != PVR2D_OK)
+			return BadImplementation;
+		return Success;
+	}
+
+	/* Back to the framebuffer as soon as the window stops qualifying. */
+	if (FlipChain.owner == pPriv)
+		pvr2DDestroyFlipChain();
+
 	DamageDamageRegion(pDraw, clipBoxes);
 
-	if (PVR2DVideoBlt
-	    (hPVR2DContext, &pvr2dextblt, texcoords,
-	     sgx_filtervalues) != PVR2D_OK)
-		return BadImplementation;
-	return Success;
+	return pvr2DBlit(pPriv, texcoords, sgx_filtervalues, vid_w, vid_h,
+			 pPixmap->drawable.width, pPixmap->drawable.height);
+}
+
+static void pvr2DClipNotify(ScrnInfoPtr pScrn, pointer data, WindowPtr pWin,
+			    int dx, int dy)
+{
+	pvr2DPortPrivPtr pPriv = (pvr2DPortPrivPtr) data;
+
+	/* Whatever now overlaps the video is in the framebuffer, not in the
+	 * flip chain buffer still on the display; the kick redraws the held
+	 * frame into the framebuffer if the window no longer qualifies. */
+	if (FlipChain.owner == pPriv)
+		pvr2DDestroyFlipChain();
+
+	omap_hold_kick(&pPriv->hold);
 }
 
 XF86VideoAdaptorPtr pvr2dSetupTexturedVideo(ScreenPtr pScreen)
@@ -467,6 +1045,7 @@ XF86VideoAdaptorPtr pvr2dSetupTexturedVideo(ScreenPtr pScreen)
 	adapt->QueryBestSize = pvr2DQueryBestSize;
 	adapt->PutImage = pvr2DPutImage;
 	adapt->QueryImageAttributes = pvr2DQueryImageAttributes;
+	adapt->ClipNotify = pvr2DClipNotify;
 
 	adapt->pPortPrivates = (DevUnion *)
 	    xcalloc(NUM_TEXTURED_XV_PORTS, sizeof(DevUnion));
@@ -480,6 +1059,11 @@ XF86VideoAdaptorPtr pvr2dSetupTexturedVideo(ScreenPtr pScreen)
 		if (!pPriv)
 			goto out_err;
 
+		pPriv->brightness = BRIGHTNESS_DEFAULT_VALUE;
+		pPriv->contrast = CONTRAST_DEFAULT_VALUE;
+		pPriv->saturation = SATURATION_DEFAULT_VALUE;
+		pPriv->hue = HUE_DEFAULT_VALUE;
+		pPriv->colorspace = COLORSPACE_DEFAULT_VALUE;
 		pvr2DSetupFilterValues(pPriv);
 
 		adapt->pPortPrivates[i].ptr = (pointer) pPriv;
@@ -490,6 +1074,14 @@ XF86VideoAdaptorPtr pvr2dSetupTexturedVideo(ScreenPtr pScreen)
 	xvContrast = MAKE_ATOM("XV_CONTRAST");
 	xvHue = MAKE_ATOM("XV_HUE");
 	xvSaturation = MAKE_ATOM("XV_SATURATION");
+	xvColorspace = MAKE_ATOM("XV_COLORSPACE");
+
+	for (i = 0; i < adapt->nPorts; i++) {
+		pPriv = adapt->pPortPrivates[i].ptr;
+		omap_hold_init(&pPriv->hold,
+			       FBDEVPTR(xf86Screens[pScreen->myNum]),
+			       pvr2DPutImage, pvr2DQueryImageAttributes, pPriv);
+	}
 
 	return adapt;
 
@@ -504,3 +1096,25 @@ out_err:
 
 	return NULL;
 }
+
+/*
+ * Free an adaptor that was never registered with Xv, with its ports; their
+ * videos must have been stopped.
+ */
+void pvr2dFreeTexturedVideo(XF86VideoAdaptorPtr adapt)
+{
+	pvr2DPortPrivPtr pPriv;
+	int i;
+
+	for (i = 0; i < adapt->nPorts; i++) {
+		pPriv = adapt->pPortPrivates[i].ptr;
+		omap_hold_fini(&pPriv->hold);
+		freeMem(&pPriv->scratch[0]);
+		freeMem(&pPriv->scratch[1]);
+		if (FlipChain.owner == pPriv)
+			pvr2DDestroyFlipChain();
+		xfree(pPriv);
+	}
+	xfree(adapt->pPortPrivates);
+	xfree(adapt);
+}
@@ -24,5 +24,7 @@
 #define SGX_XV_H 1
 
 extern XF86VideoAdaptorPtr pvr2dSetupTexturedVideo(ScreenPtr pScreen);
+extern void pvr2dFreeTexturedVideo(XF86VideoAdaptorPtr adapt);
+extern void pvr2DDestroyFlipChain(void);
 
 #endif /* SGX_XV_H */